@@ -0,0 +1,167 @@
+#include "viewManager.hpp"
+
+using namespace std;
+using namespace viewManager;
+
+/****************************************************************************************************
+The benchmark builds synthetic documents and renders them with the headless
+surface. The time of each phase is reported as JSON for the first frame,
+the frames where nothing changed and the frames where every element is
+measured again. The documents are generated the same way on each run. The
+viewer uses the number of worker threads given, one per processor when it
+is zero or not given.
+
+  ./bench.out [frames] [threads]
+***************************************************************************************************/
+
+typedef struct {
+  const char *name;
+  void (*build)(Viewer &vm);
+} scenario;
+
+/// \brief a fixed sequence of words, the same on each run.
+string words(size_t seed, size_t count) {
+  static const vector<string> vocabulary = {
+      "layout",  "render",  "glyph",   "element", "document", "paragraph",
+      "the",     "of",      "and",     "a",       "viewer",   "display",
+      "measure", "wrapped", "text",    "style",   "surface",  "font",
+      "pixel",   "width",   "height",  "line",    "box",      "cache"};
+  string s;
+  uint32_t state = static_cast<uint32_t>(seed) * 2654435761u + 1;
+  for (size_t i = 0; i < count; i++) {
+    state = state * 1664525u + 1013904223u;
+    if (i)
+      s += " ";
+    s += vocabulary[(state >> 16) % vocabulary.size()];
+  }
+  return s;
+}
+
+void deepNesting(Viewer &vm) {
+  for (size_t column = 0; column < 32; column++) {
+    Element *e = &vm.appendChild<DIV>(display::block);
+    for (size_t depth = 0; depth < 64; depth++) {
+      e = &e->appendChild<DIV>(display::block);
+      e->data() = {words(column * 64 + depth, 6)};
+    }
+  }
+}
+
+void wideSiblings(Viewer &vm) {
+  auto &list = vm.appendChild<DIV>(display::block);
+  for (size_t i = 0; i < 10000; i++)
+    list.appendChild<SPAN>(display::in_line).data() = {words(i, 2)};
+}
+
+void wrappedParagraphs(Viewer &vm) {
+  for (size_t i = 0; i < 2000; i++)
+    vm.appendChild<PARAGRAPH>(display::block).data() = {words(i, 90)};
+}
+
+void mixedData(Viewer &vm) {
+  for (size_t i = 0; i < 1000; i++) {
+    vector<int> integers;
+    vector<double> reals;
+    vector<string> strings;
+    for (size_t j = 0; j < 20; j++) {
+      integers.push_back(static_cast<int>(i * 20 + j));
+      reals.push_back((i * 20 + j) * 0.25);
+      strings.push_back(words(i * 20 + j, 3));
+    }
+    vm.appendChild<UL>(display::block).data<int>() = integers;
+    vm.appendChild<UL>(display::block).data<double>() = reals;
+    vm.appendChild<UL>(display::block).data() = strings;
+  }
+}
+
+/// \brief the phases of a frame, as a JSON object.
+string timingsJSON(const Viewer::frameTimings &t, double divisor) {
+  stringstream ss;
+  ss << fixed << setprecision(4) << "{\"style\": " << t.style / divisor
+     << ", \"measure\": " << t.measure / divisor
+     << ", \"layout\": " << t.layout / divisor
+     << ", \"displayList\": " << t.displayList / divisor
+     << ", \"render\": " << t.render / divisor
+     << ", \"flip\": " << t.flip / divisor << ", \"total\": "
+     << (t.style + t.measure + t.layout + t.displayList + t.render + t.flip) /
+            divisor
+     << "}";
+  return ss.str();
+}
+
+void accumulate(Viewer::frameTimings &sum, const Viewer::frameTimings &t) {
+  sum.style += t.style;
+  sum.measure += t.measure;
+  sum.layout += t.layout;
+  sum.displayList += t.displayList;
+  sum.render += t.render;
+  sum.flip += t.flip;
+}
+
+string runScenario(const scenario &s, size_t frames, size_t threads) {
+  auto &vm = createElement<Viewer>(
+      windowTitle{"bench"}, objectHeight{640_px}, objectWidth{800_px},
+      textFace{"arial"}, textSize{12_pt}, lineHeight::normal);
+  vm.workerThreads = threads;
+  s.build(vm);
+  size_t count = elements.size();
+
+  // the first frame measures and lays out the whole document.
+  vm.renderFrames(1);
+  Viewer::frameTimings cold = vm.timings;
+
+  // nothing changes, the previous layout is kept.
+  Viewer::frameTimings warm{};
+  for (size_t i = 0; i < frames; i++) {
+    vm.renderFrames(1);
+    accumulate(warm, vm.timings);
+  }
+
+  // every element is measured and laid out again.
+  Viewer::frameTimings invalidated{};
+  for (size_t i = 0; i < frames; i++) {
+    for (auto &n : elements)
+      n.second->setDirty();
+    vm.renderFrames(1);
+    accumulate(invalidated, vm.timings);
+  }
+
+  Viewer::wordCacheStatistics words = vm.wordCacheStatus();
+  stringstream ss;
+  ss << "    {\"name\": \"" << s.name << "\", \"elements\": " << count
+     << ", \"frames\": " << frames << ",\n     \"cold\": "
+     << timingsJSON(cold, 1) << ",\n     \"warm\": " << timingsJSON(warm, frames)
+     << ",\n     \"invalidated\": " << timingsJSON(invalidated, frames)
+     << ",\n     \"wordCache\": {\"hits\": " << words.hits
+     << ", \"misses\": " << words.misses
+     << ", \"evictions\": " << words.evictions
+     << ", \"entries\": " << words.entries << "}}";
+
+  // the document is released before the next one is built.
+  indexedElements.clear();
+  elements.clear();
+  return ss.str();
+}
+
+int main(int argc, char **argv) {
+  size_t frames = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 10;
+  if (frames == 0)
+    frames = 1;
+  size_t threads = argc > 2 ? static_cast<size_t>(atoi(argv[2])) : 0;
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  vector<scenario> scenarios = {{"deep_nesting", deepNesting},
+                                {"wide_siblings", wideSiblings},
+                                {"wrapped_paragraphs", wrappedParagraphs},
+                                {"mixed_data", mixedData}};
+
+  cout << "{\n  \"units\": \"ms\",\n  \"threads\": " << threads
+       << ",\n  \"scenarios\": [\n";
+  for (size_t i = 0; i < scenarios.size(); i++) {
+    cout << runScenario(scenarios[i], frames, threads);
+    cout << (i + 1 < scenarios.size() ? ",\n" : "\n");
+  }
+  cout << "  ]\n}" << endl;
+  return 0;
+}
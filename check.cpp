@@ -0,0 +1,130 @@
+#include "viewManager.hpp"
+
+using namespace std;
+using namespace viewManager;
+
+/****************************************************************************************************
+The check compares the SIMD span kernels of the platform with the scalar
+kernels they replace. Random spans are blended and filled by each kernel
+the processor supports, and the resulting pixels must equal those of the
+scalar kernel bit for bit. The spans are generated the same way on each
+run. The program exits with a non zero status when a kernel differs.
+
+  ./check.out [spans]
+***************************************************************************************************/
+
+typedef Visualizer::platform platform;
+
+/// \brief a fixed sequence of values, the same on each run.
+class sequence {
+public:
+  sequence(uint32_t seed) : state(seed * 2654435761u + 1) {}
+  uint32_t next(void) {
+    state = state * 1664525u + 1013904223u;
+    return (state >> 16) | (state << 16);
+  }
+  /// \brief a byte that is often zero or 255, the values glyphs mostly
+  /// have.
+  uint32_t coverage(void) {
+    uint32_t r = next() % 4;
+    return r == 0 ? 0 : r == 1 ? 255 : next() & 0xFF;
+  }
+
+private:
+  uint32_t state;
+};
+
+typedef struct {
+  const char *name;
+  platform::blendSpanFunction blend;
+  platform::fillSpanFunction fill;
+} kernel;
+
+/// \brief the pixel that differs, reported along with the span.
+string mismatch(const kernel &k, const char *routine, size_t span, int n,
+                int i, unsigned int expected, unsigned int actual) {
+  stringstream ss;
+  ss << k.name << " " << routine << ": span " << span << " of " << n
+     << " pixels differs at " << i << ", expected 0x" << hex << setw(8)
+     << setfill('0') << expected << ", got 0x" << setw(8) << actual;
+  return ss.str();
+}
+
+/// \brief blends and fills the spans with the kernel and the scalar
+/// kernels. Returns the number of spans that differ.
+size_t compare(const kernel &k, size_t spans) {
+  const int maxLength = 67;
+  vector<unsigned int> destination(maxLength);
+  vector<unsigned int> coverage(maxLength);
+  vector<unsigned int> expected(maxLength);
+  vector<unsigned int> actual(maxLength);
+  sequence s(1);
+  size_t failures = 0;
+
+  for (size_t span = 0; span < spans; span++) {
+    int n = static_cast<int>(s.next() % (maxLength + 1));
+    for (int i = 0; i < n; i++) {
+      destination[i] = s.next();
+      bool grey = span & 1;
+      uint32_t r = s.coverage();
+      uint32_t g = grey ? r : s.coverage();
+      uint32_t b = grey ? r : s.coverage();
+      coverage[i] = (r << 16) | (g << 8) | b;
+    }
+    unsigned int color = s.next();
+    unsigned int alpha = s.coverage();
+
+    expected = destination;
+    actual = destination;
+    platform::blendSpanScalar(expected.data(), coverage.data(), n, color);
+    k.blend(actual.data(), coverage.data(), n, color);
+    for (int i = 0; i < n; i++)
+      if (expected[i] != actual[i]) {
+        cerr << mismatch(k, "blendSpan", span, n, i, expected[i], actual[i])
+             << endl;
+        failures++;
+        break;
+      }
+
+    expected = destination;
+    actual = destination;
+    platform::fillSpanScalar(expected.data(), n, color, alpha);
+    k.fill(actual.data(), n, color, alpha);
+    for (int i = 0; i < n; i++)
+      if (expected[i] != actual[i]) {
+        cerr << mismatch(k, "fillSpan", span, n, i, expected[i], actual[i])
+             << endl;
+        failures++;
+        break;
+      }
+  }
+  return failures;
+}
+
+int main(int argc, char **argv) {
+  size_t spans = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 200000;
+
+  vector<kernel> kernels;
+#if defined(USE_X86_BLEND)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2"))
+    kernels.push_back({"sse2", platform::blendSpanSSE2, platform::fillSpanSSE2});
+  else
+    cout << "sse2: not supported by the processor, skipped" << endl;
+  if (__builtin_cpu_supports("avx2"))
+    kernels.push_back({"avx2", platform::blendSpanAVX2, platform::fillSpanAVX2});
+  else
+    cout << "avx2: not supported by the processor, skipped" << endl;
+#else
+  cout << "no SIMD kernels are built for this target" << endl;
+#endif
+
+  size_t failures = 0;
+  for (auto &k : kernels) {
+    size_t n = compare(k, spans);
+    cout << k.name << ": " << spans << " spans, "
+         << (n ? to_string(n) + " differ" : "identical to scalar") << endl;
+    failures += n;
+  }
+  return failures ? 1 : 0;
+}
@@ -50,6 +50,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE /* hPrevInstance */,
   // command line
 #endif
 
+  // the font files of the faces used are resolved while the document is
+  // built.
+  prewarmTextFaces({"arial"});
+
   // create the main window area. This may this is called a Viewer object.
   // The main browsing window. It is an element as well.
   auto &vm = createElement<Viewer>(
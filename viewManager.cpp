@@ -25,6 +25,15 @@
 using namespace std;
 using namespace viewManager;
 
+#if defined(__linux__)
+/**
+\internal
+\brief The mapped font files are defined before the elements, so the faces
+of the viewers are closed before the files are unmapped.
+*/
+viewManager::Visualizer::mappedFontFiles viewManager::Visualizer::mappedFonts;
+#endif
+
 /**
 \internal
 
@@ -923,7 +932,9 @@ listeners attached.
 object.
 */
 viewManager::Viewer::Viewer(const vector<any> &attrs)
-    : Element("Viewer", attrs) {
+    : Element("Viewer", attrs), overscan(256), workerThreads(0), timings(),
+      wordCacheCapacity(16384), glyphCacheBudget(4 << 20),
+      m_paintedScrollX(0), m_paintedScrollY(0) {
   setAttribute(indexBy{"_root"});
 
   documentState st;
@@ -939,476 +950,1517 @@ viewManager::Viewer::Viewer(const vector<any> &attrs)
 viewManager::Viewer::~Viewer() {}
 
 /**
-  \internal
-  \brief The function is a recursive one that calculates the
-  items that could not be resolved previously. At the completetion
-  of this functionality, all items that appear within the viewport
-  should be calculated.
+\internal
+\brief starts the worker threads. The calling thread is worker zero, so
+one less thread is created than requested.
+*/
+viewManager::threadPool::threadPool(std::size_t threads)
+    : m_queued(0), m_stop(false) {
+  if (threads == 0)
+    threads = 1;
+  for (std::size_t i = 0; i < threads; i++)
+    m_queues.push_back(std::make_unique<taskQueue>());
+  for (std::size_t i = 1; i < threads; i++)
+    m_threads.emplace_back(&threadPool::workerLoop, this, i);
+}
 
+/**
+\internal
+\brief stops and joins the worker threads.
 */
-void viewManager::Viewer::treeOrderComputeLayout(double &dpenX, double &dpenY,Element &e) {
-  doubleNF numeric = doubleNF(0_px);
-  /* the logic skips the calculation if it has already been
-     performed. Also because of the walking order, object parents
-     will already be resolved. This is a necessity for the process
-     to work.
-  */
-  if (!e.displayList.completed()) {
-    
-    // dereference for ease of syntax
-    displayListItem &listEntry = e.displayList;
-    Element &eParent = (*e.parent()).get();
-
-    /* left position */
-    if (!listEntry.bCalculatedLeft) {
-      if (listEntry.bAutoCalculateLeft) {
-        listEntry.x1 = dpenX;
-        listEntry.x1_nf = numericFormat::px;
-        listEntry.bCalculatedLeft = true;
-        listEntry.bAutoCalculateLeft = false;
-      } else if (listEntry.x1_nf == numericFormat::percent) {
-        listEntry.x1 =
-            dpenX + (eParent.displayList.oh * (listEntry.x1 / 100));
-        listEntry.x1_nf = numericFormat::px;
-        listEntry.bCalculatedLeft = true;
-        listEntry.bAutoCalculateLeft = false;
-      } else {
-        numeric = doubleNF(listEntry.x1, listEntry.x1_nf);
-        listEntry.x1 = numeric.toPx();
-        listEntry.x1_nf = numericFormat::px;
-        listEntry.bCalculatedLeft = true;
-        listEntry.bAutoCalculateLeft = false;
-      }
-    }
+viewManager::threadPool::~threadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (auto &t : m_threads)
+    t.join();
+}
 
-    /* top position */
-    if (!listEntry.bCalculatedTop) {
-      if (listEntry.bAutoCalculateTop) {
-        listEntry.y1 = dpenY;
-        listEntry.y1_nf = numericFormat::px;
-        listEntry.bCalculatedTop = true;
-        listEntry.bAutoCalculateTop = false;
-      } else if (listEntry.y1_nf == numericFormat::percent) {
-        listEntry.y1 =
-            dpenY + (eParent.displayList.oh * (listEntry.y1 / 100));
-        listEntry.y1_nf = numericFormat::px;
-        listEntry.bCalculatedTop = true;
-        listEntry.bAutoCalculateTop = false;
-      } else {
-        numeric = doubleNF(listEntry.x1, listEntry.x1_nf);
-        listEntry.y1 = numeric.toPx();
-        listEntry.y1_nf = numericFormat::px;
-        listEntry.bCalculatedTop = true;
-        listEntry.bAutoCalculateTop = false;
-      }
-    }
+/**
+\internal
+\brief runs the group of tasks and returns when all of them are complete.
+The tasks are placed upon the queue of the calling worker, which takes
+them from the back while the other workers steal from the front. While
+waiting, the caller works on any task that is queued. When there is none,
+it sleeps until the last task of the group completes or more tasks are
+queued by a nested run.
+*/
+void viewManager::threadPool::run(const std::vector<taskFunction> &tasks,
+                                  const std::size_t worker) {
+  if (tasks.empty())
+    return;
 
-    /* right position */
-    if (!listEntry.bCalculatedRight) {
-      if (listEntry.bAutoCalculateRight) {
-        // get with of the text lines, the max size
-        if (listEntry.disp == display::in_line) {
-          listEntry.ow = eParent.displayList.ow;
-          listEntry.ow_nf = numericFormat::px;
-          listEntry.ow = e.computeWidestTextData(*m_device.get());
-          // clamp to width of parent
-          if (listEntry.ow > eParent.displayList.ow)
-            listEntry.ow = eParent.displayList.ow;
-          listEntry.x2 = dpenX + listEntry.ow;
+  // not worth waking the workers
+  if (m_threads.empty() || tasks.size() == 1) {
+    for (auto &fn : tasks)
+      fn(worker);
+    return;
+  }
 
-        } else {
-          listEntry.ow_nf = numericFormat::px;
-          listEntry.x2 = eParent.displayList.x2;
-          listEntry.ow = listEntry.x2 - listEntry.x1;
-        }
-        listEntry.bCalculatedRight = true;
-        listEntry.bAutoCalculateRight = false;
-
-      } else if (listEntry.ow_nf == numericFormat::percent) {
-        listEntry.ow = ((eParent.displayList.ow) * (listEntry.ow / 100));
-        listEntry.ow_nf = numericFormat::px;
-        listEntry.x2 = dpenX + listEntry.ow;
-        listEntry.bCalculatedRight = true;
-        listEntry.bAutoCalculateRight = false;
-      } else {
-        numeric = doubleNF(listEntry.ow, listEntry.ow_nf);
-        listEntry.x2 = numeric.toPx();
-        listEntry.ow = listEntry.x2 - listEntry.x1;
-        listEntry.ow_nf = numericFormat::px;
-        listEntry.bCalculatedRight = true;
-        listEntry.bAutoCalculateRight = false;
-      }
-    }
+  taskGroup group;
+  group.pending = tasks.size();
 
-    /* bottom position */
-    if (!listEntry.bCalculatedBottom) {
-      if (listEntry.bAutoCalculateBottom) {
-        // get the height of the wrapped text in pixels.
-        listEntry.oh =
-            e.computeWrappedTextDataHeight(*m_device.get(), listEntry.ow);
-        listEntry.oh_nf = numericFormat::px;
-        listEntry.y2 = listEntry.y1 + listEntry.oh;
-        listEntry.bCalculatedBottom = true;
-        listEntry.bAutoCalculateBottom = false;
-      } else if (listEntry.oh_nf == numericFormat::percent) {
-        listEntry.oh = (eParent.displayList.oh * (listEntry.y2 / 100));
-        listEntry.oh_nf = numericFormat::px;
-        listEntry.y2 = dpenY + listEntry.oh;
-        listEntry.bCalculatedBottom = true;
-        listEntry.bAutoCalculateBottom = false;
-      } else {
-        numeric = doubleNF(listEntry.oh, listEntry.oh_nf);
-        listEntry.y2 = numeric.toPx();
-        listEntry.bCalculatedBottom = true;
-        listEntry.bAutoCalculateBottom = false;
-      }
-    }
+  // the first task is placed last so that the caller starts with it.
+  {
+    taskQueue &q = *m_queues[worker];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    for (auto it = tasks.rbegin(); it != tasks.rend(); it++)
+      q.tasks.push_back({&(*it), &group});
+    m_queued += tasks.size();
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+  }
+  m_wake.notify_all();
+  m_done.notify_all();
 
-    if(dpenX>maxX)
-      maxX=dpenX;
-    if(dpenY>maxY)
-      maxY=dpenY;
-    if(listEntry.y2 > eParent.maxY)
-      eParent.maxY=listEntry.y2;
-
-    // advance the pen based upon the display mode
-    if (listEntry.disp == display::in_line) {
-      dpenX = listEntry.x2;
-      dpenY = listEntry.y1;
-    } else if (listEntry.disp == display::block) {
-      dpenX = eParent.displayList.x1;
-      dpenY = eParent.maxY;
-      //listEntry.y2;
+  while (group.pending > 0) {
+    task t;
+    if (takeTask(worker, t)) {
+      execute(t, worker);
+      continue;
     }
 
-    if(dpenX>=eParent.displayList.ow)
-      e.penX=e.displayList.x1;
-    //if(e.penY>=e.displayList.oh)
-    //  break;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [&group, this] {
+      return group.pending == 0 || m_queued > 0;
+    });
   }
-  e.penX=dpenX;
-  e.penY=dpenY;
 
-  // iterate the children recursively.
-  for (auto &n : e.children()) {
-    treeOrderComputeLayout(e.penX, e.penY, n);
-  }
+  if (group.error)
+    std::rethrow_exception(group.error);
 }
 
 /**
-\brief The routine processes the list of elements such that the layout
-and units are all expressed within the model as pixel units. After this
-function is ran, each element will have a rectangle attached that expresses
-it's pixel size on the viewing device.
+\internal
+\brief invokes the function for each index from zero to count. The indexes
+are divided into a few ranges per worker so that faster workers steal
+the remaining ones. It is called from outside of the pool, as worker zero.
 */
-void viewManager::Viewer::computeLayout(Element &e) {
-  penX = 0;
-  penY = 0;
+void viewManager::threadPool::parallelFor(
+    const std::size_t count,
+    const std::function<void(std::size_t idx, std::size_t worker)> &fn) {
+  std::size_t ranges = std::min(count, size() * 4);
+  std::vector<taskFunction> tasks;
+  tasks.reserve(ranges);
+  for (std::size_t r = 0; r < ranges; r++) {
+    std::size_t begin = count * r / ranges;
+    std::size_t end = count * (r + 1) / ranges;
+    tasks.push_back([&fn, begin, end](std::size_t worker) {
+      for (std::size_t idx = begin; idx < end; idx++)
+        fn(idx, worker);
+    });
+  }
+  run(tasks, 0);
+}
 
-  // clear the display list.
-  m_displayList.erase(m_displayList.begin(), m_displayList.end());
+/**
+\internal
+\brief takes a task from the back of the worker's own queue, or steals one
+from the front of another.
+*/
+bool viewManager::threadPool::takeTask(const std::size_t worker, task &t) {
+  for (std::size_t i = 0; i < m_queues.size(); i++) {
+    std::size_t victim = (worker + i) % m_queues.size();
+    taskQueue &q = *m_queues[victim];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty())
+      continue;
 
-  // ensure word break and font metrics indexing are performed. 
-  // This is used to know where to wrap textual data, calculations 
-  // of widths and heights of fields.
-  for (auto &ptr : elements) {
-    Element &e = *(ptr.second.get());
-    e.wordMetrics(*m_device.get());
-    e.penX=0;
-    e.penY=0;
-    e.maxX=0;
-    e.maxY=0;
+    if (victim == worker) {
+      t = q.tasks.back();
+      q.tasks.pop_back();
+    } else {
+      t = q.tasks.front();
+      q.tasks.pop_front();
+    }
+    m_queued--;
+    return true;
   }
+  return false;
+}
 
-  /*
-   This loop establishes all items that will be involved within the
-   display of elements. As well, the loop initalizes the displayList
-   class. Breaking the process into two parts simplifies the second
-   logic in that exception handling will not be used. The loop process 
-   also resolves all calculations without dependencies than can be 
-   found such as absolute positions
-
-   A particular area of interest is exception handling that occurrs.
-   As the result, items and options are set to default, however preserving
-   the unstored state within the attribute list. The display list has the
-   defaults set within its cachce.
-  */
-  for (auto &ptr : elements) {
-    // store local reference for ease of syntax
-    Element &e = *(ptr.second.get());
-    displayListItem &listEntry = e.displayList;
+/**
+\internal
+\brief runs the task, noting the first exception of its group. The group
+belongs to the caller of run and must not be used after the count of
+pending tasks is lowered. Completing the last task of the group wakes the
+callers of run that are sleeping.
+*/
+void viewManager::threadPool::execute(task &t, const std::size_t worker) {
+  taskGroup *group = t.group;
+  try {
+    (*t.fn)(worker);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(group->errorMutex);
+    if (!group->error)
+      group->error = std::current_exception();
+  }
+  if (--group->pending == 0) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    m_done.notify_all();
+  }
+}
 
-    // items that are not displayed are not included in the list
-    try {
-      if (e.getAttribute<display>().value == display::optionEnum::none)
-        continue;
-    } catch (std::exception e) {
+/**
+\internal
+\brief the loop of a worker thread. It works on queued tasks and sleeps
+when there are none.
+*/
+void viewManager::threadPool::workerLoop(const std::size_t worker) {
+  for (;;) {
+    task t;
+    if (takeTask(worker, t)) {
+      execute(t, worker);
+      continue;
     }
 
-    // initialize base structure with defualts or the information from the
-    // class object needed for display
-    listEntry.bCalculatedTop = false;
-    listEntry.bCalculatedBottom = false;
-    listEntry.bCalculatedLeft = false;
-    listEntry.bCalculatedRight = false;
-    listEntry.bCalculatedWidth = false;
-    listEntry.bCalculatedHeight = false;
-    listEntry.bAutoCalculateTop = false;
-    listEntry.bAutoCalculateBottom = false;
-    listEntry.bAutoCalculateLeft = false;
-    listEntry.bAutoCalculateRight = false;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wake.wait(lock, [this] { return m_stop || m_queued > 0; });
+    if (m_stop)
+      return;
+  }
+}
 
-    listEntry.x1 = 0;
-    listEntry.y1 = 0;
-    listEntry.x2 = 0;
-    listEntry.y2 = 0;
-    listEntry.ow = 0;
-    listEntry.oh = 0;
-
-    try {
-      listEntry.disp = e.getAttribute<display>().value;
-    } catch (std::exception e) {
-      listEntry.disp = display::in_line;
-    }
-    try {
-      listEntry.pos = e.getAttribute<position>().value;
-    } catch (std::exception e) {
-      listEntry.pos = position::relative;
-    }
-    try {
-      listEntry.zIndex = e.getAttribute<zIndex>().value;
-    } catch (std::exception e) {
-      listEntry.zIndex = 0;
+/**
+  \internal
+  \brief The function calculates the items of the element that could not
+  be resolved previously. The pen is advanced past the element. At the
+  completetion of this functionality, the rectangle of the element is
+  calculated and its own pen is set for the layout of its children.
+
+  \details The layout is incremental. When an element and its subtree are
+  not dirty and the inputs to its calculation, the pen position and the
+  rectangle of the parent, are the same as the previous pass, the cached
+  rectangles of the subtree are reused and only the pen is advanced.
+
+  \return true when the children of the element must be laid out.
+*/
+bool viewManager::Viewer::computeElementLayout(double &dpenX, double &dpenY,
+                                               Element &e) {
+  doubleNF numeric = doubleNF(0_px);
+  displayListItem &listEntry = e.displayList;
+
+  {
+    Element &eParent = e.parent()->get();
+    displayListItem &parentEntry = eParent.displayList;
+
+    /* when nothing the element depends upon has changed, the subtree
+     keeps its rectangles. The pen and the parent's extent are advanced
+     with the values recorded the last time it was calculated. */
+    if (!e.bDirty && !e.bChildDirty && listEntry.bLayoutCached &&
+        listEntry.penXIn == dpenX && listEntry.penYIn == dpenY &&
+        listEntry.parentMaxYIn == eParent.maxY &&
+        listEntry.parentX1 == parentEntry.x1 &&
+        listEntry.parentX2 == parentEntry.x2 &&
+        listEntry.parentOw == parentEntry.ow &&
+        listEntry.parentOh == parentEntry.oh) {
+      // the extent of the document is merged by the caller for the
+      // elements below the children of the viewer.
+      if (&eParent == this) {
+        if (listEntry.subtreePenMaxX > maxX)
+          maxX = listEntry.subtreePenMaxX;
+        if (listEntry.subtreePenMaxY > maxY)
+          maxY = listEntry.subtreePenMaxY;
+      }
+      eParent.maxY = listEntry.parentMaxYOut;
+      dpenX = listEntry.penXOut;
+      dpenY = listEntry.penYOut;
+      return false;
     }
 
-    listEntry.ptr = ptr.second.get();
+    // record the inputs used for this calculation
+    listEntry.bLayoutCached = false;
+    listEntry.penXIn = dpenX;
+    listEntry.penYIn = dpenY;
+    listEntry.parentMaxYIn = eParent.maxY;
+    listEntry.parentX1 = parentEntry.x1;
+    listEntry.parentX2 = parentEntry.x2;
+    listEntry.parentOw = parentEntry.ow;
+    listEntry.parentOh = parentEntry.oh;
+    listEntry.subtreePenMaxX = 0;
+    listEntry.subtreePenMaxY = 0;
+
+    // items that are not displayed are not included in the list, neither
+    // are their children.
+    bool bDisplayNone = e.computedStyle.disp == display::optionEnum::none;
+
+    listEntry.bDisplayNone = bDisplayNone;
+    if (bDisplayNone) {
+      listEntry.bVisible = false;
+      listEntry.penXOut = dpenX;
+      listEntry.penYOut = dpenY;
+      listEntry.parentMaxYOut = eParent.maxY;
+      listEntry.bLayoutCached = true;
+      e.bDirty = false;
+      e.bChildDirty = false;
+      return false;
+    }
 
-    // the numeric value is used to hold the class while reading information
-    doubleNF numeric = doubleNF(0_px);
+    listEntry.bVisible = initializeLayout(e);
 
-    /* if items are absolute, they can be calculated
-     absolute position items must have the coordinates expressed
-     in numerical values, not percentages. When percentages are used,
-     they are resolved after their depencency is calculated.
-     So basically this first phase resolves all measurements 
-     that can be converted or calculated.
-     At times the developer using the library may choose to have absolute
-     positioning. Or let the system calculate the defaults for the terms.
+    /* the logic skips the calculation if it has already been
+       performed. Also because of the walking order, object parents
+       will already be resolved. This is a necessity for the process
+       to work.
     */
-    if (listEntry.pos == position::absolute) {
-      try {
-        numeric = e.getAttribute<objectLeft>();
-        if (numeric.option == numericFormat::percent ||
-            numeric.option == numericFormat::autoCalculate) {
-          listEntry.x1 = numeric.value;
-          listEntry.x1_nf = numeric.option;
+    if (!listEntry.completed()) {
 
+      /* left position */
+      if (!listEntry.bCalculatedLeft) {
+        if (listEntry.bAutoCalculateLeft) {
+          listEntry.x1 = dpenX;
+          listEntry.x1_nf = numericFormat::px;
+          listEntry.bCalculatedLeft = true;
+          listEntry.bAutoCalculateLeft = false;
+        } else if (listEntry.x1_nf == numericFormat::percent) {
+          listEntry.x1 =
+              dpenX + (eParent.displayList.oh * (listEntry.x1 / 100));
+          listEntry.x1_nf = numericFormat::px;
+          listEntry.bCalculatedLeft = true;
+          listEntry.bAutoCalculateLeft = false;
         } else {
+          numeric = doubleNF(listEntry.x1, listEntry.x1_nf);
           listEntry.x1 = numeric.toPx();
-          listEntry.x1_nf = numeric.option;
+          listEntry.x1_nf = numericFormat::px;
           listEntry.bCalculatedLeft = true;
+          listEntry.bAutoCalculateLeft = false;
         }
-      } catch (std::exception e) {
-        listEntry.x1_nf = numericFormat::autoCalculate;
-        listEntry.bAutoCalculateLeft = true;
       }
 
-      try {
-        numeric = e.getAttribute<objectTop>();
-        if (numeric.option == numericFormat::percent ||
-            numeric.option == numericFormat::autoCalculate) {
-          listEntry.y1 = numeric.value;
-          listEntry.y1_nf = numeric.option;
+      /* top position */
+      if (!listEntry.bCalculatedTop) {
+        if (listEntry.bAutoCalculateTop) {
+          listEntry.y1 = dpenY;
+          listEntry.y1_nf = numericFormat::px;
+          listEntry.bCalculatedTop = true;
+          listEntry.bAutoCalculateTop = false;
+        } else if (listEntry.y1_nf == numericFormat::percent) {
+          listEntry.y1 =
+              dpenY + (eParent.displayList.oh * (listEntry.y1 / 100));
+          listEntry.y1_nf = numericFormat::px;
+          listEntry.bCalculatedTop = true;
+          listEntry.bAutoCalculateTop = false;
         } else {
+          numeric = doubleNF(listEntry.x1, listEntry.x1_nf);
           listEntry.y1 = numeric.toPx();
-          listEntry.y1_nf = numeric.option;
+          listEntry.y1_nf = numericFormat::px;
           listEntry.bCalculatedTop = true;
+          listEntry.bAutoCalculateTop = false;
         }
-      } catch (std::exception e) {
-        listEntry.y1_nf = numericFormat::autoCalculate;
-        listEntry.bAutoCalculateTop = true;
       }
-    }
-
-    /*
-    These series of tests performs the logic of calculation when the value
-    can be determined without other dependency. If the item is not found
-    within the structure or if its option is set to auto calculate, the auto
-    calculate option is turned on within the display list structure.
-    */
 
-    /**************************************************** x1 object left */
-    if (!listEntry.bCalculatedLeft) {
-      try {
-        numeric = e.getAttribute<objectLeft>();
-        if (numeric.option == numericFormat::autoCalculate) {
-          listEntry.bAutoCalculateLeft = true;
-          listEntry.x1_nf = numeric.option;
+      /* right position */
+      if (!listEntry.bCalculatedRight) {
+        if (listEntry.bAutoCalculateRight) {
+          // get with of the text lines, the max size
+          if (listEntry.disp == display::in_line) {
+            listEntry.ow = eParent.displayList.ow;
+            listEntry.ow_nf = numericFormat::px;
+            listEntry.ow = e.computeWidestTextData(*m_device.get());
+            // clamp to width of parent
+            if (listEntry.ow > eParent.displayList.ow)
+              listEntry.ow = eParent.displayList.ow;
+            listEntry.x2 = dpenX + listEntry.ow;
+
+          } else {
+            listEntry.ow_nf = numericFormat::px;
+            listEntry.x2 = eParent.displayList.x2;
+            listEntry.ow = listEntry.x2 - listEntry.x1;
+          }
+          listEntry.bCalculatedRight = true;
+          listEntry.bAutoCalculateRight = false;
 
-        } else if (numeric.option == numericFormat::percent) {
-          listEntry.x1 = numeric.value;
-          listEntry.x1_nf = numeric.option;
+        } else if (listEntry.ow_nf == numericFormat::percent) {
+          listEntry.ow = ((eParent.displayList.ow) * (listEntry.ow / 100));
+          listEntry.ow_nf = numericFormat::px;
+          listEntry.x2 = dpenX + listEntry.ow;
+          listEntry.bCalculatedRight = true;
+          listEntry.bAutoCalculateRight = false;
+        } else {
+          numeric = doubleNF(listEntry.ow, listEntry.ow_nf);
+          listEntry.x2 = numeric.toPx();
+          listEntry.ow = listEntry.x2 - listEntry.x1;
+          listEntry.ow_nf = numericFormat::px;
+          listEntry.bCalculatedRight = true;
+          listEntry.bAutoCalculateRight = false;
+        }
+      }
 
+      /* bottom position */
+      if (!listEntry.bCalculatedBottom) {
+        if (listEntry.bAutoCalculateBottom) {
+          // get the height of the wrapped text in pixels.
+          listEntry.oh = e.computeWrappedTextDataHeight(listEntry.ow);
+          listEntry.oh_nf = numericFormat::px;
+          listEntry.y2 = listEntry.y1 + listEntry.oh;
+          listEntry.bCalculatedBottom = true;
+          listEntry.bAutoCalculateBottom = false;
+        } else if (listEntry.oh_nf == numericFormat::percent) {
+          listEntry.oh = (eParent.displayList.oh * (listEntry.y2 / 100));
+          listEntry.oh_nf = numericFormat::px;
+          listEntry.y2 = dpenY + listEntry.oh;
+          listEntry.bCalculatedBottom = true;
+          listEntry.bAutoCalculateBottom = false;
         } else {
-          listEntry.x1 = numeric.toPx();
-          listEntry.x1_nf = numericFormat::px;
-          listEntry.bCalculatedLeft = true;
+          numeric = doubleNF(listEntry.oh, listEntry.oh_nf);
+          listEntry.y2 = numeric.toPx();
+          listEntry.bCalculatedBottom = true;
+          listEntry.bAutoCalculateBottom = false;
         }
+      }
 
-      } catch (std::exception e) {
-        listEntry.x1_nf = numericFormat::autoCalculate;
-        listEntry.bAutoCalculateLeft = true;
+      if (&eParent == this) {
+        if (dpenX > maxX)
+          maxX = dpenX;
+        if (dpenY > maxY)
+          maxY = dpenY;
       }
+      if (listEntry.y2 > eParent.maxY)
+        eParent.maxY = listEntry.y2;
+
+      listEntry.subtreePenMaxX = dpenX;
+      listEntry.subtreePenMaxY = dpenY;
+
+      // advance the pen based upon the display mode
+      if (listEntry.disp == display::in_line) {
+        dpenX = listEntry.x2;
+        dpenY = listEntry.y1;
+      } else if (listEntry.disp == display::block) {
+        dpenX = eParent.displayList.x1;
+        dpenY = eParent.maxY;
+        // listEntry.y2;
+      }
+
+      if (dpenX >= eParent.displayList.ow)
+        e.penX = e.displayList.x1;
+      // if(e.penY>=e.displayList.oh)
+      //  break;
     }
 
-    /**************************************************** y1 object top */
-    if (!listEntry.bCalculatedTop) {
-      try {
-        numeric = e.getAttribute<objectTop>();
+    listEntry.penXOut = dpenX;
+    listEntry.penYOut = dpenY;
+    listEntry.parentMaxYOut = eParent.maxY;
+  }
+
+  e.penX = dpenX;
+  e.penY = dpenY;
+  e.maxX = 0;
+  e.maxY = 0;
+  return true;
+}
+
+/**
+  \internal
+  \brief The function is a recursive one that lays out the children of an
+  element whose rectangle is calculated. The rectangles of the children are
+  calculated in order since each advances the pen of the element. The
+  subtree below a child only depends upon the rectangle and pen of that
+  child, so the subtrees are laid out concurrently upon the worker pool.
+
+  \details The children of the viewer are the exception. The pens within
+  their subtrees advance the extent of the document, maxX and maxY of the
+  viewer, which the following children read when placed as a block. Their
+  subtrees are laid out in order, each merging its extent before the next
+  child is placed. The elements below them merge their extent through
+  subtreePenMaxX and subtreePenMaxY rather than writing the viewer.
+*/
+void viewManager::Viewer::treeOrderComputeLayout(Element &e,
+                                                 const std::size_t worker) {
+  displayListItem &listEntry = e.displayList;
+  std::vector<threadPool::taskFunction> subtrees;
 
-        if (numeric.option == numericFormat::autoCalculate) {
-          listEntry.bAutoCalculateTop = true;
-          listEntry.y1_nf = numeric.option;
+  for (auto &n : e.children()) {
+    if (!computeElementLayout(e.penX, e.penY, n))
+      continue;
 
-        } else if (numeric.option == numericFormat::percent) {
-          listEntry.y1 = numeric.value;
-          listEntry.y1_nf = numeric.option;
+    if (&e == this) {
+      treeOrderComputeLayout(n, worker);
+      if (n.displayList.subtreePenMaxX > maxX)
+        maxX = n.displayList.subtreePenMaxX;
+      if (n.displayList.subtreePenMaxY > maxY)
+        maxY = n.displayList.subtreePenMaxY;
 
-        } else {
-          listEntry.y1 = numeric.toPx();
-          listEntry.y1_nf = numericFormat::px;
-          listEntry.bCalculatedTop = true;
-        }
+    } else if (n.childCount() == 0) {
+      treeOrderComputeLayout(n, worker);
 
-      } catch (std::exception e) {
-        listEntry.y1_nf = numericFormat::autoCalculate;
-        listEntry.bAutoCalculateTop = true;
+    } else {
+      Element *pn = &n;
+      subtrees.push_back(
+          [this, pn](std::size_t w) { treeOrderComputeLayout(*pn, w); });
+    }
+  }
+
+  m_workers->run(subtrees, worker);
+
+  // note the greatest pen positions reached within the subtree
+  for (auto &n : e.children()) {
+    if (n.displayList.subtreePenMaxX > listEntry.subtreePenMaxX)
+      listEntry.subtreePenMaxX = n.displayList.subtreePenMaxX;
+    if (n.displayList.subtreePenMaxY > listEntry.subtreePenMaxY)
+      listEntry.subtreePenMaxY = n.displayList.subtreePenMaxY;
+  }
+
+  listEntry.bLayoutCached = true;
+  e.bDirty = false;
+  e.bChildDirty = false;
+}
+
+/**
+\internal
+\brief The routine appends the display records of an element along with
+those of its children, in tree order. It is invoked once the layout of the
+document is complete. The offset and clipping rectangle are those of the
+scrolling elements that contain the element. An element that has a
+scrollTop or scrollLeft attribute moves its children by them and clips
+them to its own rectangle. Items that are clipped entirely are not listed.
+*/
+void viewManager::Viewer::appendDisplayList(Element &e, double scrollX,
+                                            double scrollY, double clipX1,
+                                            double clipY1, double clipX2,
+                                            double clipY2) {
+  displayListItem &listEntry = e.displayList;
+  if (!listEntry.bLayoutCached)
+    return;
+
+  if (listEntry.bDisplayNone)
+    return;
+
+  listEntry.scrollX = scrollX;
+  listEntry.scrollY = scrollY;
+  listEntry.clipX1 = clipX1;
+  listEntry.clipY1 = clipY1;
+  listEntry.clipX2 = clipX2;
+  listEntry.clipY2 = clipY2;
+  listEntry.paintX1 =
+      std::max(std::min(listEntry.x1, listEntry.x2) - scrollX, clipX1);
+  listEntry.paintY1 =
+      std::max(std::min(listEntry.y1, listEntry.y2) - scrollY, clipY1);
+  listEntry.paintX2 =
+      std::min(std::max(listEntry.x1, listEntry.x2) - scrollX, clipX2);
+  listEntry.paintY2 =
+      std::min(std::max(listEntry.y1, listEntry.y2) - scrollY, clipY2);
+
+  if (listEntry.bVisible && listEntry.paintX1 <= listEntry.paintX2 &&
+      listEntry.paintY1 <= listEntry.paintY2)
+    m_displayList.push_back(&listEntry);
+
+  // the scrolling of the viewer is applied when painting.
+  if (&e != this) {
+    scrollLeft *pLeft = e.tryGetAttribute<scrollLeft>();
+    scrollTop *pTop = e.tryGetAttribute<scrollTop>();
+    if (pLeft || pTop) {
+      scrollX += pLeft ? pLeft->toPx() : 0;
+      scrollY += pTop ? pTop->toPx() : 0;
+      clipX1 = listEntry.paintX1;
+      clipY1 = listEntry.paintY1;
+      clipX2 = listEntry.paintX2;
+      clipY2 = listEntry.paintY2;
+    }
+  }
+
+  for (auto &n : e.children())
+    appendDisplayList(n, scrollX, scrollY, clipX1, clipY1, clipX2, clipY2);
+}
+
+/**
+\internal
+\brief The routine initializes the display record of an element before its
+layout is calculated. All of the measurements that can be resolved without
+dependencies, such as absolute positions, are converted here.
+
+The values are read from the computed style of the element. Items and
+options that are not set have their defaults there, preserving the
+unstored state within the attribute list. The display list has the
+defaults set within its cachce.
+
+\return false when the element has no visible area and should not be
+included within the display list.
+*/
+bool viewManager::Viewer::initializeLayout(Element &e) {
+  displayListItem &listEntry = e.displayList;
+
+  // initialize base structure with defualts or the information from the
+  // class object needed for display
+  listEntry.bCalculatedTop = false;
+  listEntry.bCalculatedBottom = false;
+  listEntry.bCalculatedLeft = false;
+  listEntry.bCalculatedRight = false;
+  listEntry.bCalculatedWidth = false;
+  listEntry.bCalculatedHeight = false;
+  listEntry.bAutoCalculateTop = false;
+  listEntry.bAutoCalculateBottom = false;
+  listEntry.bAutoCalculateLeft = false;
+  listEntry.bAutoCalculateRight = false;
+
+  listEntry.x1 = 0;
+  listEntry.y1 = 0;
+  listEntry.x2 = 0;
+  listEntry.y2 = 0;
+  listEntry.ow = 0;
+  listEntry.oh = 0;
+
+  const ComputedStyle &cs = e.computedStyle;
+  listEntry.disp = cs.disp;
+  listEntry.pos = cs.pos;
+  listEntry.zIndex = cs.zIndex;
+
+  listEntry.ptr = &e;
+
+  // the numeric value is used to hold the class while reading information
+  doubleNF numeric = doubleNF(0_px);
+
+  /* if items are absolute, they can be calculated
+   absolute position items must have the coordinates expressed
+   in numerical values, not percentages. When percentages are used,
+   they are resolved after their depencency is calculated.
+   So basically this first phase resolves all measurements
+   that can be converted or calculated.
+   At times the developer using the library may choose to have absolute
+   positioning. Or let the system calculate the defaults for the terms.
+  */
+  if (listEntry.pos == position::absolute) {
+    if (cs.left) {
+      numeric = *cs.left;
+      if (numeric.option == numericFormat::percent ||
+          numeric.option == numericFormat::autoCalculate) {
+        listEntry.x1 = numeric.value;
+        listEntry.x1_nf = numeric.option;
+
+      } else {
+        listEntry.x1 = numeric.toPx();
+        listEntry.x1_nf = numeric.option;
+        listEntry.bCalculatedLeft = true;
+      }
+    } else {
+      listEntry.x1_nf = numericFormat::autoCalculate;
+      listEntry.bAutoCalculateLeft = true;
+    }
+
+    if (cs.top) {
+      numeric = *cs.top;
+      if (numeric.option == numericFormat::percent ||
+          numeric.option == numericFormat::autoCalculate) {
+        listEntry.y1 = numeric.value;
+        listEntry.y1_nf = numeric.option;
+      } else {
+        listEntry.y1 = numeric.toPx();
+        listEntry.y1_nf = numeric.option;
+        listEntry.bCalculatedTop = true;
       }
+    } else {
+      listEntry.y1_nf = numericFormat::autoCalculate;
+      listEntry.bAutoCalculateTop = true;
     }
+  }
+
+  /*
+  These series of tests performs the logic of calculation when the value
+  can be determined without other dependency. If the item is not found
+  within the structure or if its option is set to auto calculate, the auto
+  calculate option is turned on within the display list structure.
+  */
 
-    /**************************************************** object width */
-    try {
-      numeric = e.getAttribute<objectWidth>();
+  /**************************************************** x1 object left */
+  if (!listEntry.bCalculatedLeft) {
+    if (cs.left) {
+      numeric = *cs.left;
       if (numeric.option == numericFormat::autoCalculate) {
-        listEntry.bAutoCalculateRight = true;
-        listEntry.ow_nf = numeric.option;
+        listEntry.bAutoCalculateLeft = true;
+        listEntry.x1_nf = numeric.option;
 
       } else if (numeric.option == numericFormat::percent) {
-        listEntry.ow = numeric.value;
-        listEntry.ow_nf = numeric.option;
+        listEntry.x1 = numeric.value;
+        listEntry.x1_nf = numeric.option;
 
       } else {
-        listEntry.ow = numeric.toPx();
-        listEntry.ow_nf = numericFormat::px;
-        // if the width is less than zero, it will
-        // not be visible, so do not include it
-        if (listEntry.ow <= 0.0)
-          continue;
-        listEntry.bCalculatedWidth = true;
+        listEntry.x1 = numeric.toPx();
+        listEntry.x1_nf = numericFormat::px;
+        listEntry.bCalculatedLeft = true;
       }
-    } catch (std::exception e) {
-      listEntry.ow_nf = numericFormat::autoCalculate;
-      listEntry.bAutoCalculateRight = true;
+
+    } else {
+      listEntry.x1_nf = numericFormat::autoCalculate;
+      listEntry.bAutoCalculateLeft = true;
     }
+  }
+
+  /**************************************************** y1 object top */
+  if (!listEntry.bCalculatedTop) {
+    if (cs.top) {
+      numeric = *cs.top;
 
-    /**************************************************** object height */
-    try {
-      numeric = e.getAttribute<objectHeight>();
       if (numeric.option == numericFormat::autoCalculate) {
-        listEntry.bAutoCalculateBottom = true;
-        listEntry.oh_nf = numeric.option;
+        listEntry.bAutoCalculateTop = true;
+        listEntry.y1_nf = numeric.option;
 
       } else if (numeric.option == numericFormat::percent) {
-        listEntry.oh = numeric.value;
-        listEntry.oh_nf = numeric.option;
+        listEntry.y1 = numeric.value;
+        listEntry.y1_nf = numeric.option;
 
       } else {
-        listEntry.oh = numeric.toPx();
-        listEntry.oh_nf = numericFormat::px;
-        // if the height is less than zero,
-        // it will not be visible, so do not include it
-        if (listEntry.oh <= 0.0)
-          continue;
-        listEntry.bCalculatedHeight = true;
+        listEntry.y1 = numeric.toPx();
+        listEntry.y1_nf = numericFormat::px;
+        listEntry.bCalculatedTop = true;
       }
-    } catch (std::exception e) {
-      listEntry.oh_nf = numericFormat::autoCalculate;
-      listEntry.bAutoCalculateBottom = true;
-    }
 
-    // if the preceeding operations were resolved to find the widths or
-    // heights and the top or left coordinates are also known, the bottom
-    // may be found as well.
-    /**************************************************** object bottom */
-    if (listEntry.bCalculatedLeft && listEntry.bCalculatedWidth) {
-      listEntry.x2 = listEntry.x1 + listEntry.ow;
-      listEntry.bCalculatedRight = true;
-      listEntry.bAutoCalculateRight = false;
+    } else {
+      listEntry.y1_nf = numericFormat::autoCalculate;
+      listEntry.bAutoCalculateTop = true;
     }
+  }
 
-    /**************************************************** object top */
-    if (listEntry.bCalculatedTop && listEntry.bCalculatedHeight) {
-      listEntry.y2 = listEntry.y1 + listEntry.oh;
-      listEntry.bCalculatedBottom = true;
-      listEntry.bAutoCalculateBottom = false;
-    }
+  /**************************************************** object width */
+  if (cs.width) {
+    numeric = *cs.width;
+    if (numeric.option == numericFormat::autoCalculate) {
+      listEntry.bAutoCalculateRight = true;
+      listEntry.ow_nf = numeric.option;
+
+    } else if (numeric.option == numericFormat::percent) {
+      listEntry.ow = numeric.value;
+      listEntry.ow_nf = numeric.option;
 
-  // add the item to the list and set the index.
-  // this stores the direct link to the calculation record
-  // within the vector.
-  listInsertion:
-    m_displayList.push_back(&e.displayList);
+    } else {
+      listEntry.ow = numeric.toPx();
+      listEntry.ow_nf = numericFormat::px;
+      // if the width is less than zero, it will
+      // not be visible, so do not include it
+      if (listEntry.ow <= 0.0)
+        return false;
+      listEntry.bCalculatedWidth = true;
+    }
+  } else {
+    listEntry.ow_nf = numericFormat::autoCalculate;
+    listEntry.bAutoCalculateRight = true;
   }
 
-  /*
-  The second phase walks the document object model to resolve uncalculated
-  items that are relative, or percentage based that require the parent
-  to be calculated first. With respect to the priming rectangle, the
-  document viewer object or _root is established by the _w and _h
-  properties. These values are directly linked to the window size.
-  These values are placed into the object here since they can be
-  calculated directly.
-  */
-  Viewer &eRoot = getElement<Viewer>("_root");
-  eRoot.displayList.bAutoCalculateTop = false;
-  eRoot.displayList.bAutoCalculateLeft = false;
-  eRoot.displayList.bAutoCalculateBottom = false;
-  eRoot.displayList.bAutoCalculateRight = false;
+  /**************************************************** object height */
+  if (cs.height) {
+    numeric = *cs.height;
+    if (numeric.option == numericFormat::autoCalculate) {
+      listEntry.bAutoCalculateBottom = true;
+      listEntry.oh_nf = numeric.option;
 
-  eRoot.displayList.bCalculatedLeft = true;
-  eRoot.displayList.x1 = 0;
-  eRoot.displayList.bCalculatedTop = true;
-  eRoot.displayList.y1 = 0;
-  eRoot.displayList.bCalculatedRight = true;
-  eRoot.displayList.x2 = eRoot.getAttribute<objectWidth>().toPx();
-  eRoot.displayList.ow = eRoot.getAttribute<objectWidth>().toPx();
-  eRoot.displayList.bCalculatedBottom = true;
-  eRoot.displayList.y2 = eRoot.getAttribute<objectHeight>().toPx();
-  eRoot.displayList.oh = eRoot.getAttribute<objectHeight>().toPx();
+    } else if (numeric.option == numericFormat::percent) {
+      listEntry.oh = numeric.value;
+      listEntry.oh_nf = numeric.option;
 
-  // recursively walk the document and calculate layout.
-  treeOrderComputeLayout(eRoot.penX, eRoot.penY, eRoot);
+    } else {
+      listEntry.oh = numeric.toPx();
+      listEntry.oh_nf = numericFormat::px;
+      // if the height is less than zero,
+      // it will not be visible, so do not include it
+      if (listEntry.oh <= 0.0)
+        return false;
+      listEntry.bCalculatedHeight = true;
+    }
+  } else {
+    listEntry.oh_nf = numericFormat::autoCalculate;
+    listEntry.bAutoCalculateBottom = true;
+  }
 
-  // sort the displayList by left, top, and zOrder
-  sort(m_displayList.begin(), m_displayList.end(),
-       [](displayListItem *a, displayListItem *b) {
-         return a->x1 < b->x1 && a->y1 < b->y1 && a->zIndex < b->zIndex;
-       });
-}
+  // if the preceeding operations were resolved to find the widths or
+  // heights and the top or left coordinates are also known, the bottom
+  // may be found as well.
+  /**************************************************** object bottom */
+  if (listEntry.bCalculatedLeft && listEntry.bCalculatedWidth) {
+    listEntry.x2 = listEntry.x1 + listEntry.ow;
+    listEntry.bCalculatedRight = true;
+    listEntry.bAutoCalculateRight = false;
+  }
 
-/**
+  /**************************************************** object top */
+  if (listEntry.bCalculatedTop && listEntry.bCalculatedHeight) {
+    listEntry.y2 = listEntry.y1 + listEntry.oh;
+    listEntry.bCalculatedBottom = true;
+    listEntry.bAutoCalculateBottom = false;
+  }
+
+  return true;
+}
+
+/**
+\internal
+\brief The routine provides the region of the document, in the coordinates
+of the display list's painted bounds, within which the text of elements is
+measured word by word. It is the viewport moved by the scrolling of the
+viewer and enlarged by the overscan.
+*/
+void viewManager::Viewer::measureRegion(double &x1, double &y1, double &x2,
+                                        double &y2) {
+  scrollLeft *pLeft = tryGetAttribute<scrollLeft>();
+  scrollTop *pTop = tryGetAttribute<scrollTop>();
+  double dScrollX = pLeft ? pLeft->toPx() : 0;
+  double dScrollY = pTop ? pTop->toPx() : 0;
+
+  x1 = dScrollX - overscan;
+  y1 = dScrollY - overscan;
+  x2 = dScrollX + computedStyle.width.value().toPx() + overscan;
+  y2 = dScrollY + computedStyle.height.value().toPx() + overscan;
+}
+
+/**
+\internal
+\brief The routine measures the words of the elements on the workers. Each
+worker uses its own font context.
+*/
+void viewManager::Viewer::measureWords(
+    std::vector<std::pair<Element *, FTC_FaceID>> &work) {
+  if (work.empty())
+    return;
+
+  m_workers->parallelFor(work.size(), [&](std::size_t idx,
+                                          std::size_t worker) {
+    work[idx].first->wordMetrics(*m_measureContexts[worker], work[idx].second);
+  });
+}
+
+/**
+\internal
+\brief The routine gives the element estimated metrics. The face height
+and the average advance are measured once for each face and point size.
+*/
+void viewManager::Viewer::estimateText(Element &e, FTC_FaceID faceID) {
+  int pointSize = static_cast<int>(e.computedStyle.textSize);
+  auto it = m_faceEstimates.find({faceID, pointSize});
+  if (it == m_faceEstimates.end()) {
+    static const std::string sSample =
+        "The quick brown fox jumps over the lazy dog 0123456789";
+    Visualizer::fontContext &fonts = *m_measureContexts[0];
+    double dHeight = fonts.measureFaceHeight(faceID, pointSize);
+    double dAdvance =
+        fonts.measureTextWidth(faceID, pointSize, sSample) / sSample.size();
+    it = m_faceEstimates
+             .insert({{faceID, pointSize}, {dHeight, dAdvance}})
+             .first;
+  }
+  e.estimateWordMetrics(it->second.second, it->second.first);
+}
+
+/**
+\internal
+\brief The routine provides the word metrics of the elements that changed.
+Those that were painted near the viewport the last time are measured word
+by word. The others, along with those that have not been laid out, receive
+estimated metrics. They are measured once the layout places them near.
+*/
+void viewManager::Viewer::measureText(void) {
+  while (m_measureContexts.size() < m_workers->size())
+    m_measureContexts.push_back(std::make_unique<Visualizer::fontContext>());
+
+  // a change of the font scale changes every measure.
+  if (m_measureContexts[0]->fontScale != m_device->fontScale)
+    m_faceEstimates.clear();
+  for (auto &n : m_measureContexts) {
+    n->fontScale = m_device->fontScale;
+    n->words.capacity = wordCacheCapacity;
+  }
+
+  double x1, y1, x2, y2;
+  measureRegion(x1, y1, x2, y2);
+
+  std::vector<std::pair<Element *, FTC_FaceID>> work;
+  for (auto &ptr : elements) {
+    Element &n = *(ptr.second.get());
+    if (!n.bDirty)
+      continue;
+
+    FTC_FaceID faceID = m_device->getFaceID(n.computedStyle.textFace);
+    const displayListItem &d = n.displayList;
+    if (d.bLayoutCached && d.paintX2 >= x1 && d.paintX1 <= x2 &&
+        d.paintY2 >= y1 && d.paintY1 <= y2)
+      work.push_back({&n, faceID});
+    else
+      estimateText(n, faceID);
+  }
+
+  measureWords(work);
+}
+
+/**
+\internal
+\brief The routine returns the counters of the word width caches summed
+over the text measurement workers.
+*/
+viewManager::Viewer::wordCacheStatistics
+viewManager::Viewer::wordCacheStatus(void) {
+  wordCacheStatistics ret{};
+  for (auto &n : m_measureContexts) {
+    ret.hits += n->words.hits;
+    ret.misses += n->words.misses;
+    ret.evictions += n->words.evictions;
+    ret.entries += n->words.size();
+  }
+  return ret;
+}
+
+/**
+\internal
+\brief The routine returns the counters of the glyph atlases.
+*/
+viewManager::Viewer::glyphCacheStatistics
+viewManager::Viewer::glyphCacheStatus(void) {
+  glyphCacheStatistics ret{};
+  if (m_device) {
+    Visualizer::glyphAtlasCache &glyphs = m_device->glyphAtlases;
+    ret = {glyphs.hits, glyphs.misses, glyphs.evictions, glyphs.bytes()};
+  }
+  return ret;
+}
+
+/**
+\internal
+\brief The routine measures the words of the elements that the layout
+placed near the viewport while having estimated metrics. An element whose
+words were evicted keeps its rectangle, since the height retained for its
+width is the measured one. The others are marked dirty.
+
+\return true when the layout must be calculated again.
+*/
+bool viewManager::Viewer::measureVisibleText(void) {
+  double x1, y1, x2, y2;
+  measureRegion(x1, y1, x2, y2);
+  m_displayIndex.query(x1, y1, x2, y2, m_visibleItems);
+
+  std::vector<std::pair<Element *, FTC_FaceID>> work;
+  for (auto idx : m_visibleItems) {
+    Element &n = *m_displayList[idx]->ptr;
+    if (n.bEstimatedMetrics)
+      work.push_back({&n, m_device->getFaceID(n.computedStyle.textFace)});
+  }
+
+  if (work.empty())
+    return false;
+
+  // the rectangles laid out with a retained height remain.
+  std::vector<std::pair<double, double>> retained;
+  for (auto &n : work)
+    retained.push_back({n.first->retainedWrapWidth,
+                        n.first->retainedTextHeight});
+
+  measureWords(work);
+
+  bool bRelayout = false;
+  for (std::size_t idx = 0; idx < work.size(); idx++) {
+    Element &n = *work[idx].first;
+    if (retained[idx].first >= 0 &&
+        retained[idx].first == n.displayList.ow) {
+      n.retainedWrapWidth = retained[idx].first;
+      n.retainedTextHeight = retained[idx].second;
+    } else {
+      n.setDirty();
+      bRelayout = true;
+    }
+  }
+  return bRelayout;
+}
+
+/**
+\internal
+\brief The routine releases the word breaks of the elements painted far
+from the viewport, further than the size of the measured region. The memory
+used by the text metrics therefore follows the viewport rather than the
+size of the document.
+*/
+void viewManager::Viewer::evictText(void) {
+  double x1, y1, x2, y2;
+  measureRegion(x1, y1, x2, y2);
+  double dw = x2 - x1;
+  double dh = y2 - y1;
+  x1 -= dw;
+  x2 += dw;
+  y1 -= dh;
+  y2 += dh;
+
+  for (auto n : m_displayList) {
+    if (n->ptr->bEstimatedMetrics)
+      continue;
+    if (n->paintX2 < x1 || n->paintX1 > x2 || n->paintY2 < y1 ||
+        n->paintY1 > y2)
+      n->ptr->evictWordMetrics();
+  }
+}
+
+/**
+\internal
+\brief The routine resolves the computed style of the element and then of
+its children, so that each inherits from a resolved parent.
+*/
+void viewManager::Viewer::treeOrderResolveStyle(Element &e) {
+  e.resolveStyle();
+  for (auto &n : e.children())
+    treeOrderResolveStyle(n);
+}
+
+/**
+\brief The routine processes the list of elements such that the layout
+and units are all expressed within the model as pixel units. After this
+function is ran, each element will have a rectangle attached that expresses
+it's pixel size on the viewing device. Only the elements that are dirty
+are measured again. The display list is rebuilt in tree order.
+
+The text of elements far from the viewport is estimated. Once laid out,
+the estimated elements that are placed near the viewport are measured and
+the layout is calculated again, a few times at most since the estimates
+move the elements that follow them.
+*/
+void viewManager::Viewer::computeLayout(Element &e) {
+  const int maxRefinements = 4;
+
+  if (!m_workers)
+    m_workers = std::make_unique<threadPool>(
+        workerThreads ? workerThreads : std::thread::hardware_concurrency());
+
+  timings.style = 0;
+  timings.measure = 0;
+  timings.layout = 0;
+  timings.displayList = 0;
+  std::chrono::steady_clock::time_point lap = std::chrono::steady_clock::now();
+
+  // resolve the styles, parents first. Elements whose resolved style
+  // changes are marked dirty.
+  Viewer &eRoot = getElement<Viewer>("_root");
+  treeOrderResolveStyle(eRoot);
+  timings.style += lapTime(lap);
+
+  // ensure word break and font metrics indexing are performed for the
+  // elements that changed. This is used to know where to wrap textual data,
+  // calculations of widths and heights of fields.
+  measureText();
+  timings.measure += lapTime(lap);
+  layoutDocument();
+
+  for (int i = 0; i < maxRefinements; i++) {
+    lap = std::chrono::steady_clock::now();
+    bool bRelayout = measureVisibleText();
+    timings.measure += lapTime(lap);
+    if (!bRelayout)
+      break;
+    layoutDocument();
+  }
+
+  lap = std::chrono::steady_clock::now();
+  evictText();
+  timings.measure += lapTime(lap);
+}
+
+/**
+\internal
+\brief returns the milliseconds elapsed since the lap began, and begins
+the next lap.
+*/
+double
+viewManager::Viewer::lapTime(std::chrono::steady_clock::time_point &lap) {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  double ms = std::chrono::duration<double, std::milli>(now - lap).count();
+  lap = now;
+  return ms;
+}
+
+/**
+\internal
+\brief The routine lays out the document, reusing the rectangles of the
+subtrees that did not change, and builds the display list again when the
+document changed.
+*/
+void viewManager::Viewer::layoutDocument(void) {
+  penX = 0;
+  penY = 0;
+  maxX = 0;
+  maxY = 0;
+  std::chrono::steady_clock::time_point lap = std::chrono::steady_clock::now();
+
+  Viewer &eRoot = getElement<Viewer>("_root");
+
+  // each change within the document marks the path to the root, so when
+  // the root is clean the display list of the previous pass is kept.
+  bool bDocumentChanged = eRoot.bDirty || eRoot.bChildDirty;
+
+  /*
+  The layout walks the document object model to resolve uncalculated
+  items that are relative, or percentage based that require the parent
+  to be calculated first. With respect to the priming rectangle, the
+  document viewer object or _root is established by the _w and _h
+  properties. These values are directly linked to the window size.
+  These values are placed into the object here since they can be
+  calculated directly.
+  */
+  eRoot.displayList.bVisible = initializeLayout(eRoot);
+  eRoot.displayList.subtreePenMaxX = 0;
+  eRoot.displayList.subtreePenMaxY = 0;
+
+  eRoot.displayList.bAutoCalculateTop = false;
+  eRoot.displayList.bAutoCalculateLeft = false;
+  eRoot.displayList.bAutoCalculateBottom = false;
+  eRoot.displayList.bAutoCalculateRight = false;
+
+  eRoot.displayList.bCalculatedLeft = true;
+  eRoot.displayList.x1 = 0;
+  eRoot.displayList.bCalculatedTop = true;
+  eRoot.displayList.y1 = 0;
+  eRoot.displayList.bCalculatedRight = true;
+  eRoot.displayList.x2 = eRoot.computedStyle.width.value().toPx();
+  eRoot.displayList.ow = eRoot.displayList.x2;
+  eRoot.displayList.bCalculatedBottom = true;
+  eRoot.displayList.y2 = eRoot.computedStyle.height.value().toPx();
+  eRoot.displayList.oh = eRoot.displayList.y2;
+
+  // recursively walk the document and calculate layout.
+  treeOrderComputeLayout(eRoot, 0);
+  timings.layout += lapTime(lap);
+
+  if (!bDocumentChanged)
+    return;
+
+  // the display list holds the visible elements in tree order. The stable
+  // sort orders them by zIndex, keeping the tree order within a plane. The
+  // viewer itself does not clip, the document extends past the viewport.
+  const double dUnbounded = std::numeric_limits<double>::max();
+  m_displayList.erase(m_displayList.begin(), m_displayList.end());
+  appendDisplayList(eRoot, 0, 0, -dUnbounded, -dUnbounded, dUnbounded,
+                    dUnbounded);
+  std::stable_sort(m_displayList.begin(), m_displayList.end(),
+                   [](displayListItem *a, displayListItem *b) {
+                     return a->zIndex < b->zIndex;
+                   });
+  m_displayIndex.build(m_displayList);
+  timings.displayList += lapTime(lap);
+}
+
+/**
 \internal
 \brief main entry point for the rendering subsystem. The head of
-the recursive process.
+the recursive process. The scrolling of the viewer is applied here, so
+that it does not require the layout to be calculated again. Only the
+damaged rectangles of the surface are cleared and painted, each by the
+items that intersect it, clipped to it. The painting is recorded and the
+pixels are then painted by tiles on the workers.
 */
 void viewManager::Viewer::render(void) {
   computeLayout(*this);
+  std::chrono::steady_clock::time_point lap = std::chrono::steady_clock::now();
+
+  scrollLeft *pLeft = tryGetAttribute<scrollLeft>();
+  scrollTop *pTop = tryGetAttribute<scrollTop>();
+  double dScrollX = pLeft ? pLeft->toPx() : 0;
+  double dScrollY = pTop ? pTop->toPx() : 0;
+  double dWidth = displayList.ow;
+  double dHeight = displayList.oh;
+
+  Visualizer::platform &device = *m_device.get();
+  device.glyphAtlases.budget = glyphCacheBudget;
+  device.glyphAtlases.trim();
+  damageChanges(dScrollX, dScrollY);
+  device.beginFrame();
+  device.beginPaint();
+
+  for (auto &r : device.damage.rectangles()) {
+    device.clear(r.x1, r.y1, r.x2, r.y2);
+
+    /* the display list is sorted in painting order. The spatial index
+    provides the items that intersect the rectangle, in the same order. */
+    m_displayIndex.query(dScrollX + r.x1, dScrollY + r.y1, dScrollX + r.x2,
+                         dScrollY + r.y2, m_visibleItems);
+
+    for (auto idx : m_visibleItems) {
+      displayListItem &n = *m_displayList[idx];
+
+      // the item paints within its painted bounds, those tracked by the
+      // damage. They are in document coordinates.
+      double dClipX1 = std::max(n.paintX1 - dScrollX, 0.0);
+      double dClipY1 = std::max(n.paintY1 - dScrollY, 0.0);
+      double dClipX2 = std::min(n.paintX2 - dScrollX, dWidth);
+      double dClipY2 = std::min(n.paintY2 - dScrollY, dHeight);
+
+      device.setOrigin(static_cast<int>(std::round(dScrollX + n.scrollX)),
+                       static_cast<int>(std::round(dScrollY + n.scrollY)));
+      device.setClip(std::max(static_cast<int>(std::floor(dClipX1)), r.x1),
+                     std::max(static_cast<int>(std::floor(dClipY1)), r.y1),
+                     std::min(static_cast<int>(std::ceil(dClipX2)), r.x2),
+                     std::min(static_cast<int>(std::ceil(dClipY2)), r.y2));
+      n.ptr->render(device);
+    }
+  }
+  device.endPaint(*m_workers);
+  device.setOrigin(0, 0);
+  device.resetClip();
+  timings.render = lapTime(lap);
+}
 
-  /* the display list is a sorted entity providing a searchable list
-  for the beginning and ending of a viewport clipping region. */
-  for (auto n : m_displayList) {
-    n->ptr->render(*m_device.get());
+/**
+\internal
+\brief notes the damage of the surface since the last frame. When the
+viewer scrolled by whole pixels, the pixels painted are moved along with
+the rectangles of the elements, so only the band uncovered is painted.
+Otherwise all of the surface is damaged. The elements that scroll their
+children are moved alike by scrollPixels. The visible items are then
+compared to the rectangles the elements were painted to. Those that
+moved damage both rectangles, those that changed damage theirs, and the
+elements no longer painted damage their former rectangles.
+*/
+void viewManager::Viewer::damageChanges(const double dScrollX,
+                                        const double dScrollY) {
+  Visualizer::platform &device = *m_device.get();
+  double dWidth = displayList.ow;
+  double dHeight = displayList.oh;
+  auto whole = [](const double d) { return d == std::floor(d); };
+
+  if (dScrollX != m_paintedScrollX || dScrollY != m_paintedScrollY) {
+    if (whole(dScrollX) && whole(dScrollY) && whole(m_paintedScrollX) &&
+        whole(m_paintedScrollY)) {
+      int dx = static_cast<int>(m_paintedScrollX - dScrollX);
+      int dy = static_cast<int>(m_paintedScrollY - dScrollY);
+      device.scroll(0, 0, static_cast<int>(std::ceil(dWidth)),
+                    static_cast<int>(std::ceil(dHeight)), dx, dy);
+      for (auto &n : m_painted) {
+        n.second.x1 += dx;
+        n.second.y1 += dy;
+        n.second.x2 += dx;
+        n.second.y2 += dy;
+      }
+    } else {
+      device.invalidate(0, 0, static_cast<int>(std::ceil(dWidth)),
+                        static_cast<int>(std::ceil(dHeight)));
+    }
+    m_paintedScrollX = dScrollX;
+    m_paintedScrollY = dScrollY;
+  }
+
+  m_displayIndex.query(dScrollX, dScrollY, dScrollX + dWidth,
+                       dScrollY + dHeight, m_visibleItems);
+
+  // the painted bounds of an item on the surface.
+  auto surfaceRectangle = [dScrollX, dScrollY](const displayListItem &n) {
+    return Visualizer::damageRegion::rectangle{
+        static_cast<int>(std::floor(n.paintX1 - dScrollX)),
+        static_cast<int>(std::floor(n.paintY1 - dScrollY)),
+        static_cast<int>(std::ceil(n.paintX2 - dScrollX)),
+        static_cast<int>(std::ceil(n.paintY2 - dScrollY))};
+  };
+
+  m_paintingScrolls.clear();
+  for (auto idx : m_visibleItems) {
+    displayListItem &n = *m_displayList[idx];
+    if (n.ptr == this)
+      continue;
+
+    scrollLeft *pLeft = n.ptr->tryGetAttribute<scrollLeft>();
+    scrollTop *pTop = n.ptr->tryGetAttribute<scrollTop>();
+    if (!pLeft && !pTop)
+      continue;
+
+    // an element that did not scroll when painted did not clip its
+    // children, its pixels are not moved.
+    scrollOffset s = {pLeft ? pLeft->toPx() : 0, pTop ? pTop->toPx() : 0};
+    m_paintingScrolls[n.ptr] = s;
+    auto it = m_paintedScrolls.find(n.ptr);
+    if (it == m_paintedScrolls.end())
+      continue;
+
+    scrollOffset &o = it->second;
+    if ((o.x != s.x || o.y != s.y) && whole(s.x) && whole(s.y) &&
+        whole(o.x) && whole(o.y))
+      scrollPixels(idx, surfaceRectangle(n), static_cast<int>(o.x - s.x),
+                   static_cast<int>(o.y - s.y));
+  }
+  std::swap(m_paintedScrolls, m_paintingScrolls);
+
+  m_painting.clear();
+  for (auto idx : m_visibleItems) {
+    displayListItem &n = *m_displayList[idx];
+    Visualizer::damageRegion::rectangle r = surfaceRectangle(n);
+
+    auto it = m_painted.find(n.ptr);
+    if (it == m_painted.end()) {
+      device.invalidate(r.x1, r.y1, r.x2, r.y2);
+    } else {
+      Visualizer::damageRegion::rectangle &o = it->second;
+      if (n.ptr->bDamaged || o.x1 != r.x1 || o.y1 != r.y1 || o.x2 != r.x2 ||
+          o.y2 != r.y2) {
+        device.invalidate(o.x1, o.y1, o.x2, o.y2);
+        device.invalidate(r.x1, r.y1, r.x2, r.y2);
+      }
+      m_painted.erase(it);
+    }
+
+    n.ptr->bDamaged = false;
+    m_painting[n.ptr] = r;
+  }
+
+  // the elements that are not painted now, their pixels are cleared.
+  for (auto &n : m_painted)
+    device.invalidate(n.second.x1, n.second.y1, n.second.x2, n.second.y2);
+
+  std::swap(m_painted, m_painting);
+}
+
+/**
+\internal
+\brief moves the pixels of the children of the scrolling element at the
+position of the display list, when that paints the same as painting them
+again. The element must be painted where it was, on whole pixels, with an
+opaque background that covers what is behind it and no border, radius or
+text that would move along. Only its descendants may be painted over it.
+The rectangles of the descendants follow the pixels, clipped to the
+element, those moved outside of it are no longer painted. Only the
+elements of the current display list are looked at, the others painted
+by the last frame damage where their pixels moved to. Returns false when
+the pixels are left for the rectangles to damage.
+*/
+bool viewManager::Viewer::scrollPixels(
+    const std::size_t idx, const Visualizer::damageRegion::rectangle &r,
+    const int dx, const int dy) {
+  displayListItem &n = *m_displayList[idx];
+  Element *e = n.ptr;
+  const ComputedStyle &style = e->computedStyle;
+
+  auto it = m_painted.find(e);
+  if (it == m_painted.end() || e->bDamaged)
+    return false;
+  const Visualizer::damageRegion::rectangle &o = it->second;
+  if (o.x1 != r.x1 || o.y1 != r.y1 || o.x2 != r.x2 || o.y2 != r.y2)
+    return false;
+  if (r.x1 != n.paintX1 - m_paintedScrollX ||
+      r.y1 != n.paintY1 - m_paintedScrollY ||
+      r.x2 != n.paintX2 - m_paintedScrollX ||
+      r.y2 != n.paintY2 - m_paintedScrollY)
+    return false;
+
+  if (!style.bBackground || style.opacity < 1 ||
+      (style.border != borderStyle::none && style.borderWidth > 0) ||
+      style.borderRadius > 0 || !e->lineBoxes.empty())
+    return false;
+
+  auto within = [e](Element &d) {
+    for (auto p = d.parent(); p; p = p->get().parent())
+      if (&p->get() == e)
+        return true;
+    return false;
+  };
+
+  std::vector<std::size_t> over;
+  m_displayIndex.query(n.paintX1, n.paintY1, n.paintX2, n.paintY2, over);
+  for (auto i : over)
+    if (i > idx && !within(*m_displayList[i]->ptr))
+      return false;
+
+  std::unordered_set<Element *> visible;
+  for (auto i : m_visibleItems)
+    visible.insert(m_displayList[i]->ptr);
+
+  m_device->scroll(r.x1, r.y1, r.x2, r.y2, dx, dy);
+  for (auto p = m_painted.begin(); p != m_painted.end();) {
+    Visualizer::damageRegion::rectangle &d = p->second;
+    Visualizer::damageRegion::rectangle m = {
+        std::max(d.x1 + dx, r.x1), std::max(d.y1 + dy, r.y1),
+        std::min(d.x2 + dx, r.x2), std::min(d.y2 + dy, r.y2)};
+
+    // the former rectangle of an element not painted now is damaged along
+    // with the others no longer painted.
+    if (!visible.count(p->first)) {
+      if (d.x1 < r.x2 && r.x1 < d.x2 && d.y1 < r.y2 && r.y1 < d.y2)
+        m_device->invalidate(m.x1, m.y1, m.x2, m.y2);
+      p++;
+      continue;
+    }
+
+    if (!within(*p->first)) {
+      p++;
+      continue;
+    }
+
+    d = m;
+    if (d.x1 >= d.x2 || d.y1 >= d.y2)
+      p = m_painted.erase(p);
+    else
+      p++;
+  }
+  return true;
+}
+
+/**
+\internal
+\brief forgets the element, which is about to be freed. The rectangle it
+was painted to is damaged, the damage moves with the pixels when they
+are scrolled before the next frame is painted.
+*/
+void viewManager::Viewer::releasePainting(Element &e) {
+  auto it = m_painted.find(&e);
+  if (it != m_painted.end()) {
+    if (m_device)
+      m_device->invalidate(it->second.x1, it->second.y1, it->second.x2,
+                           it->second.y2);
+    m_painted.erase(it);
   }
+  m_paintedScrolls.erase(&e);
+}
+
+/**
+\brief returns the element painted at the given position of the viewer,
+the last one painted when several overlap. The layout is brought up to
+date when the document has changed.
+*/
+auto viewManager::Viewer::elementFromPoint(const double x, const double y)
+    -> std::optional<std::reference_wrapper<Element>> {
+  // the display list must not refer to elements that have been removed.
+  if ((bDirty || bChildDirty) && m_device)
+    computeLayout(*this);
+
+  scrollLeft *pLeft = tryGetAttribute<scrollLeft>();
+  scrollTop *pTop = tryGetAttribute<scrollTop>();
+  double dScrollX = pLeft ? pLeft->toPx() : 0;
+  double dScrollY = pTop ? pTop->toPx() : 0;
+
+  std::optional<std::size_t> idx = m_displayIndex.itemAt(x + dScrollX,
+                                                         y + dScrollY);
+  if (!idx)
+    return std::nullopt;
+  return std::optional<std::reference_wrapper<Element>>{
+      *m_displayList[*idx]->ptr};
+}
+
+/**
+\internal
+\brief builds the grid over the painted bounds of the items. The cells are
+enlarged when the extent of the document would need too many of them.
+*/
+void viewManager::spatialIndex::build(
+    const std::vector<displayListItem *> &items) {
+  const std::size_t maxCells = 1 << 16;
+
+  m_items = &items;
+  m_cells.clear();
+  m_seen.assign(items.size(), 0);
+  m_queryID = 0;
+  m_columns = 0;
+  m_rows = 0;
+
+  if (items.empty())
+    return;
+
+  double x1 = std::numeric_limits<double>::max();
+  double y1 = std::numeric_limits<double>::max();
+  double x2 = std::numeric_limits<double>::lowest();
+  double y2 = std::numeric_limits<double>::lowest();
+  for (auto n : items) {
+    x1 = std::min(x1, n->paintX1);
+    y1 = std::min(y1, n->paintY1);
+    x2 = std::max(x2, n->paintX2);
+    y2 = std::max(y2, n->paintY2);
+  }
+
+  m_x = x1;
+  m_y = y1;
+  m_cellSize = 128;
+  for (;;) {
+    m_columns = static_cast<std::size_t>((x2 - x1) / m_cellSize) + 1;
+    m_rows = static_cast<std::size_t>((y2 - y1) / m_cellSize) + 1;
+    if (m_columns * m_rows <= maxCells)
+      break;
+    m_cellSize *= 2;
+  }
+  m_cells.resize(m_columns * m_rows);
+
+  for (std::size_t idx = 0; idx < items.size(); idx++) {
+    displayListItem &n = *items[idx];
+    std::size_t c1, r1, c2, r2;
+    if (!cellRange(n.paintX1, n.paintY1, n.paintX2, n.paintY2, c1, r1, c2,
+                   r2))
+      continue;
+    for (std::size_t r = r1; r <= r2; r++)
+      for (std::size_t c = c1; c <= c2; c++)
+        m_cells[r * m_columns + c].push_back(idx);
+  }
+}
+
+/**
+\internal
+\brief finds the cells covered by the rectangle, clamped to the grid.
+\return false when the rectangle is outside of the grid.
+*/
+bool viewManager::spatialIndex::cellRange(double x1, double y1, double x2,
+                                          double y2, std::size_t &c1,
+                                          std::size_t &r1, std::size_t &c2,
+                                          std::size_t &r2) {
+  if (x2 < x1)
+    std::swap(x1, x2);
+  if (y2 < y1)
+    std::swap(y1, y2);
+
+  double maxX = m_x + m_columns * m_cellSize;
+  double maxY = m_y + m_rows * m_cellSize;
+  if (m_cells.empty() || x2 < m_x || y2 < m_y || x1 >= maxX || y1 >= maxY)
+    return false;
+
+  auto cell = [this](double v, double origin, std::size_t count) {
+    double d = (v - origin) / m_cellSize;
+    if (d < 0)
+      return std::size_t{0};
+    return std::min(static_cast<std::size_t>(d), count - 1);
+  };
+
+  c1 = cell(x1, m_x, m_columns);
+  c2 = cell(x2, m_x, m_columns);
+  r1 = cell(y1, m_y, m_rows);
+  r2 = cell(y2, m_y, m_rows);
+  return true;
+}
+
+/**
+\internal
+\brief provides the positions of the items whose rectangle intersects the
+given one. The positions are in painting order.
+*/
+void viewManager::spatialIndex::query(const double x1, const double y1,
+                                      const double x2, const double y2,
+                                      std::vector<std::size_t> &result) {
+  result.clear();
+  std::size_t c1, r1, c2, r2;
+  if (!cellRange(x1, y1, x2, y2, c1, r1, c2, r2))
+    return;
+
+  m_queryID++;
+  for (std::size_t r = r1; r <= r2; r++) {
+    for (std::size_t c = c1; c <= c2; c++) {
+      for (auto idx : m_cells[r * m_columns + c]) {
+        if (m_seen[idx] == m_queryID)
+          continue;
+        m_seen[idx] = m_queryID;
+
+        displayListItem &n = *(*m_items)[idx];
+        if (n.paintX2 < x1 || n.paintX1 > x2 || n.paintY2 < y1 ||
+            n.paintY1 > y2)
+          continue;
+        result.push_back(idx);
+      }
+    }
+  }
+  std::sort(result.begin(), result.end());
+}
+
+/**
+\internal
+\brief provides the position of the last painted item that contains the
+point.
+*/
+std::optional<std::size_t> viewManager::spatialIndex::itemAt(const double x,
+                                                             const double y) {
+  std::size_t c1, r1, c2, r2;
+  if (!cellRange(x, y, x, y, c1, r1, c2, r2))
+    return std::nullopt;
+
+  std::optional<std::size_t> ret;
+  for (auto idx : m_cells[r1 * m_columns + c1]) {
+    displayListItem &n = *(*m_items)[idx];
+    if (x >= n.paintX1 && x < n.paintX2 && y >= n.paintY1 && y < n.paintY2)
+      ret = idx;
+  }
+  return ret;
 }
 
 /**
@@ -1426,11 +2478,13 @@ processed from a queue and using a background thread.
 */
 void viewManager::Viewer::dispatchEvent(const event &evt) {
   switch (evt.evtType) {
-  case eventType::paint:
-    m_device->clear();
+  case eventType::paint: {
     render();
-    m_device->flip();
-    break;
+    std::chrono::steady_clock::time_point lap =
+        std::chrono::steady_clock::now();
+    m_device->present();
+    timings.flip = lapTime(lap);
+  } break;
   case eventType::resize:
     setAttribute<objectWidth>(
         {static_cast<double>(evt.width), numericFormat::px});
@@ -1462,6 +2516,9 @@ void viewManager::Viewer::dispatchEvent(const event &evt) {
       m_device->fontScale++;
     else
       m_device->fontScale--;
+    // the font size changes the measurement of every element.
+    for (auto &n : elements)
+      n.second->setDirty();
     dispatchEvent(event{eventType::paint});
     break;
   case eventType::wheel:
@@ -1469,6 +2526,8 @@ void viewManager::Viewer::dispatchEvent(const event &evt) {
       m_device->fontScale += 1;
     else
       m_device->fontScale -= 1;
+    for (auto &n : elements)
+      n.second->setDirty();
     dispatchEvent(event{eventType::paint});
     break;
   }
@@ -1504,11 +2563,53 @@ void viewManager::Viewer::processEvents(void) {
       ev, getAttribute<objectWidth>().value,
       getAttribute<objectHeight>().value);
 
+#if defined(USE_HEADLESS_PLATFORM)
+  m_device->openHeadless();
+  dispatchEvent(event{eventType::paint});
+#else
   m_device->openWindow(getAttribute<windowTitle>().value);
+#if defined(__linux__)
+  // the first frame is drawn now, the window shows it when exposed.
+  dispatchEvent(event{eventType::paint});
+#endif
+#endif
 
   m_device->messageLoop();
 }
 
+/**
+\brief renders the document the given number of times into an offscreen
+buffer, without a window or display. The surface is created the first
+time, at the size of the viewer. This serves the rendering of documents
+on servers and the timing of the rendering.
+
+\param frames the number of frames to render.
+*/
+void viewManager::Viewer::renderFrames(const std::size_t frames) {
+  if (!m_device) {
+    eventHandler ev =
+        std::bind(&Viewer::dispatchEvent, this, std::placeholders::_1);
+    m_device = std::make_unique<Visualizer::platform>(
+        ev, getAttribute<objectWidth>().value,
+        getAttribute<objectHeight>().value);
+    m_device->openHeadless();
+  }
+
+  for (std::size_t i = 0; i < frames; i++)
+    dispatchEvent(event{eventType::paint});
+}
+
+/**
+\brief writes the last rendered frame as a portable pixmap, PPM, file.
+
+\param sFilename the name of the file to write.
+*/
+void viewManager::Viewer::writeImage(const std::string &sFilename) {
+  if (!m_device)
+    throw std::runtime_error("No frame has been rendered.");
+  m_device->writeImage(sFilename);
+}
+
 /**
 \addtogroup udl User Defined Literals
 
@@ -1659,6 +2760,17 @@ elements or groups of elements can be accessed through query strings.
 @ for style,
 
 */
+/**
+\brief The function begins resolving the font files of the textFace names
+on another thread. An application calls it at startup with the faces its
+document uses so the first frame does not wait for fontconfig.
+*/
+void viewManager::prewarmTextFaces(const std::vector<std::string> &faces) {
+#if defined(__linux__)
+  Visualizer::fontFiles.prewarm(faces);
+#endif
+}
+
 auto viewManager::query(const std::string &queryString) -> ElementList {
   ElementList results;
   if (queryString == "*") {
@@ -1761,6 +2873,14 @@ viewManager::Element::Element(const Element &other) {
   m_childCount = other.m_childCount;
   attributes = other.attributes;
   styles = other.styles;
+  bDirty = true;
+  bChildDirty = true;
+  bDamaged = true;
+  bStyleDirty = true;
+  m_styleParentGeneration = 0;
+  bEstimatedMetrics = false;
+  retainedWrapWidth = -1;
+  lineBoxWidth = -1;
 }
 
 /**
@@ -1780,6 +2900,14 @@ viewManager::Element::Element(Element &&other) noexcept {
   m_childCount = other.m_childCount;
   attributes = std::move(other.attributes);
   styles = std::move(other.styles);
+  bDirty = true;
+  bChildDirty = true;
+  bDamaged = true;
+  bStyleDirty = true;
+  m_styleParentGeneration = 0;
+  bEstimatedMetrics = false;
+  retainedWrapWidth = -1;
+  lineBoxWidth = -1;
 }
 
 /**
@@ -1802,6 +2930,8 @@ Element &viewManager::Element::operator=(const Element &other) {
   m_childCount = other.m_childCount;
   attributes = other.attributes;
   styles = other.styles;
+  setDirty();
+  bStyleDirty = true;
   return *this;
 }
 
@@ -1824,6 +2954,8 @@ Element &viewManager::Element::operator=(Element &&other) noexcept {
   m_childCount = other.m_childCount;
   attributes = std::move(other.attributes);
   styles = std::move(other.styles);
+  setDirty();
+  bStyleDirty = true;
   return *this;
 }
 
@@ -1872,6 +3004,7 @@ auto viewManager::Element::appendChild(Element &newChild) -> Element & {
   m_lastChild = newChild.m_self;
   m_childCount++;
 
+  newChild.setDirty();
   return (newChild);
 }
 
@@ -1940,6 +3073,7 @@ auto viewManager::Element::append(Element &sibling) -> Element & {
   this->m_parent->m_lastChild = sibling.m_self;
 
   this->m_parent->m_childCount++;
+  sibling.setDirty();
   return (sibling);
 }
 
@@ -1996,6 +3130,20 @@ Example
 Element &viewManager::Element::setAttribute(const std::any &paramSetting) {
 
   std::any setting = paramSetting;
+
+  // the scroll offsets only move what is painted. Those of the viewer are
+  // applied while painting, those of an element require the display list
+  // to be built again, yet not the layout.
+  if (paramSetting.type() == typeid(scrollTop) ||
+      paramSetting.type() == typeid(scrollLeft)) {
+    attributes.set(setting);
+    if (m_parent)
+      m_parent->setChildDirty();
+    return *this;
+  }
+
+  setDirty();
+  bStyleDirty = true;
   /**
   \internal
   \enum _enumTypeFilter
@@ -2158,10 +3306,71 @@ Element &viewManager::Element::setAttribute(const std::any &paramSetting) {
   }
 
   if (bSaveInMap)
-    attributes[std::type_index(setting.type())] = setting;
+    attributes.set(setting);
   return *this;
 }
 
+/**
+\internal
+\brief The function returns the slot of an attribute type. Types that are
+not attribute classes return attributeSlot::count.
+*/
+std::size_t viewManager::attributeTable::slotOf(const std::type_index &ti) {
+#define ATTRIBUTE_SLOT_ENTRY(NAME)                                             \
+  { std::type_index(typeid(NAME)), NAME::slotIndex }
+
+  static const std::unordered_map<std::type_index, std::size_t> slotMap = {
+      ATTRIBUTE_SLOT_ENTRY(indexBy),       ATTRIBUTE_SLOT_ENTRY(display),
+      ATTRIBUTE_SLOT_ENTRY(position),      ATTRIBUTE_SLOT_ENTRY(objectTop),
+      ATTRIBUTE_SLOT_ENTRY(objectLeft),    ATTRIBUTE_SLOT_ENTRY(objectHeight),
+      ATTRIBUTE_SLOT_ENTRY(objectWidth),   ATTRIBUTE_SLOT_ENTRY(scrollTop),
+      ATTRIBUTE_SLOT_ENTRY(scrollLeft),    ATTRIBUTE_SLOT_ENTRY(background),
+      ATTRIBUTE_SLOT_ENTRY(opacity),       ATTRIBUTE_SLOT_ENTRY(textFace),
+      ATTRIBUTE_SLOT_ENTRY(textSize),      ATTRIBUTE_SLOT_ENTRY(textWeight),
+      ATTRIBUTE_SLOT_ENTRY(textColor),     ATTRIBUTE_SLOT_ENTRY(textAlignment),
+      ATTRIBUTE_SLOT_ENTRY(textIndent),    ATTRIBUTE_SLOT_ENTRY(tabSize),
+      ATTRIBUTE_SLOT_ENTRY(lineHeight),    ATTRIBUTE_SLOT_ENTRY(marginTop),
+      ATTRIBUTE_SLOT_ENTRY(marginLeft),    ATTRIBUTE_SLOT_ENTRY(marginBottom),
+      ATTRIBUTE_SLOT_ENTRY(marginRight),   ATTRIBUTE_SLOT_ENTRY(paddingTop),
+      ATTRIBUTE_SLOT_ENTRY(paddingLeft),   ATTRIBUTE_SLOT_ENTRY(paddingBottom),
+      ATTRIBUTE_SLOT_ENTRY(paddingRight),  ATTRIBUTE_SLOT_ENTRY(borderStyle),
+      ATTRIBUTE_SLOT_ENTRY(borderWidth),   ATTRIBUTE_SLOT_ENTRY(borderColor),
+      ATTRIBUTE_SLOT_ENTRY(borderRadius),  ATTRIBUTE_SLOT_ENTRY(focusIndex),
+      ATTRIBUTE_SLOT_ENTRY(zIndex),        ATTRIBUTE_SLOT_ENTRY(listStyleType),
+      ATTRIBUTE_SLOT_ENTRY(windowTitle)};
+#undef ATTRIBUTE_SLOT_ENTRY
+
+  auto it = slotMap.find(ti);
+  if (it == slotMap.end())
+    return static_cast<std::size_t>(attributeSlot::count);
+  return it->second;
+}
+
+/**
+\internal
+\brief The function stores the attribute. An attribute class is placed
+within its slot, keeping the dense vector ordered by slot. Other types are
+stored by their type index.
+*/
+void viewManager::attributeTable::set(const std::any &setting) {
+  std::type_index ti = std::type_index(setting.type());
+  std::size_t slot = slotOf(ti);
+
+  if (slot == static_cast<std::size_t>(attributeSlot::count)) {
+    m_other[ti] = setting;
+    return;
+  }
+
+  uint64_t bit = uint64_t{1} << slot;
+  std::size_t idx = rank(slot);
+  if (m_presence & bit) {
+    m_values[idx] = setting;
+  } else {
+    m_values.insert(m_values.begin() + idx, setting);
+    m_presence |= bit;
+  }
+}
+
 /**
 \internal
 \brief The attribute being set can be contained in an array of std::any
@@ -2175,6 +3384,198 @@ viewManager::Element::setAttribute(const std::vector<std::any> &attribs) {
   return *this;
 }
 
+/**
+\internal
+\brief notes that the element must be measured and laid out again. The
+ancestors are marked so that the layout pass walks down to the element
+while reusing the other subtrees.
+*/
+void viewManager::Element::setDirty(void) {
+  bDirty = true;
+  bDamaged = true;
+  if (m_parent)
+    m_parent->setChildDirty();
+}
+
+/**
+\internal
+\brief notes that the element is about to be freed. The viewer at the root
+of its tree damages the rectangle it was painted to and forgets it, so
+that an element later allocated at the same address is not taken for it.
+*/
+void viewManager::Element::releasePainting(void) {
+  Element *root = this;
+  while (root->m_parent)
+    root = root->m_parent;
+  if (Viewer *viewer = dynamic_cast<Viewer *>(root))
+    viewer->releasePainting(*this);
+}
+
+/**
+\internal
+\brief marks the element and its ancestors as having a dirty subtree. The
+walk stops at the first ancestor that is already marked.
+*/
+void viewManager::Element::setChildDirty(void) {
+  for (Element *p = this; p && !p->bChildDirty; p = p->m_parent)
+    p->bChildDirty = true;
+}
+
+std::size_t viewManager::ComputedStyle::lastGeneration = 0;
+
+/**
+\internal
+\brief copies the values that children inherit from their parent.
+*/
+void viewManager::ComputedStyle::inherit(const ComputedStyle &parent) {
+  textFace = parent.textFace;
+  textSize = parent.textSize;
+  textColor = parent.textColor;
+  align = parent.align;
+  lineHeight = parent.lineHeight;
+}
+
+/**
+\internal
+\brief applies the attributes that are set within the table over the
+current values. A percentage text size is relative to the size that is
+inherited.
+*/
+void viewManager::ComputedStyle::apply(attributeTable &attrs) {
+  auto rgb = [](const colorNF &c) {
+    return (static_cast<unsigned int>(c.value[0]) << 16) |
+           (static_cast<unsigned int>(c.value[1]) << 8) |
+           static_cast<unsigned int>(c.value[2]);
+  };
+
+  if (viewManager::textFace *p = attrs.find<viewManager::textFace>())
+    textFace = p->value;
+
+  if (viewManager::textSize *p = attrs.find<viewManager::textSize>()) {
+    if (p->option == numericFormat::percent)
+      textSize = textSize * p->value / 100.0;
+    else
+      textSize = p->toPt();
+  }
+
+  if (viewManager::textColor *p = attrs.find<viewManager::textColor>())
+    textColor = rgb(*p);
+
+  if (textAlignment *p = attrs.find<textAlignment>())
+    align = p->value;
+
+  // only the normal option is a multiple of the face height.
+  if (viewManager::lineHeight *p = attrs.find<viewManager::lineHeight>())
+    lineHeight =
+        p->option == viewManager::lineHeight::normal ? p->value : 1.0;
+
+  if (display *p = attrs.find<display>())
+    disp = p->value;
+  if (position *p = attrs.find<position>())
+    pos = p->value;
+  if (viewManager::zIndex *p = attrs.find<viewManager::zIndex>())
+    zIndex = p->value;
+
+  if (objectLeft *p = attrs.find<objectLeft>())
+    left = *p;
+  if (objectTop *p = attrs.find<objectTop>())
+    top = *p;
+  if (objectWidth *p = attrs.find<objectWidth>())
+    width = *p;
+  if (objectHeight *p = attrs.find<objectHeight>())
+    height = *p;
+
+  if (viewManager::background *p = attrs.find<viewManager::background>()) {
+    bBackground = true;
+    background = rgb(*p);
+  }
+  if (viewManager::opacity *p = attrs.find<viewManager::opacity>())
+    opacity = std::clamp(p->value, 0.0, 1.0);
+  if (borderStyle *p = attrs.find<borderStyle>())
+    border = p->value;
+  if (viewManager::borderWidth *p = attrs.find<viewManager::borderWidth>())
+    borderWidth = p->toPx();
+  if (viewManager::borderColor *p = attrs.find<viewManager::borderColor>())
+    borderColor = rgb(*p);
+  if (viewManager::borderRadius *p = attrs.find<viewManager::borderRadius>())
+    borderRadius = p->value;
+}
+
+/**
+\internal
+\brief compares the resolved values. The generation is not compared.
+*/
+bool viewManager::ComputedStyle::operator==(const ComputedStyle &other) const {
+  auto sameNumeric = [](const std::optional<doubleNF> &a,
+                        const std::optional<doubleNF> &b) {
+    if (!a || !b)
+      return !a && !b;
+    return a->value == b->value && a->option == b->option;
+  };
+
+  return textFace == other.textFace && textSize == other.textSize &&
+         textColor == other.textColor && align == other.align &&
+         lineHeight == other.lineHeight && disp == other.disp &&
+         pos == other.pos && zIndex == other.zIndex &&
+         sameNumeric(left, other.left) && sameNumeric(top, other.top) &&
+         sameNumeric(width, other.width) &&
+         sameNumeric(height, other.height) &&
+         bBackground == other.bBackground && background == other.background &&
+         opacity == other.opacity && border == other.border &&
+         borderWidth == other.borderWidth &&
+         borderColor == other.borderColor &&
+         borderRadius == other.borderRadius;
+}
+
+/**
+\internal
+\brief resolves the computed style of the element. The parent must be
+resolved first. When neither the attributes, the attached style classes nor
+the parent's style changed, the function returns without work. When the
+resolved values differ from the previous ones, the element is marked dirty
+so that its metrics and layout are calculated again.
+*/
+void viewManager::Element::resolveStyle(void) {
+  std::size_t parentGeneration =
+      m_parent ? m_parent->computedStyle.generation : 0;
+
+  // the styles vector is public, so the signature notes the style classes
+  // and their versions used the last time.
+  bool bStylesChanged = m_styleSignature.size() != styles.size();
+  for (std::size_t i = 0; !bStylesChanged && i < styles.size(); i++) {
+    const StyleClass &sc = styles[i].get();
+    bStylesChanged = m_styleSignature[i].first != &sc ||
+                     m_styleSignature[i].second != sc.version;
+  }
+
+  if (!bStyleDirty && !bStylesChanged &&
+      parentGeneration == m_styleParentGeneration &&
+      computedStyle.generation != 0)
+    return;
+
+  if (bStylesChanged) {
+    m_styleSignature.clear();
+    for (auto &n : styles)
+      m_styleSignature.push_back({&n.get(), n.get().version});
+  }
+
+  ComputedStyle cs;
+  if (m_parent)
+    cs.inherit(m_parent->computedStyle);
+  for (auto &n : styles)
+    cs.apply(n.get().attributes);
+  cs.apply(attributes);
+
+  if (computedStyle.generation == 0 || cs != computedStyle) {
+    cs.generation = ++ComputedStyle::lastGeneration;
+    computedStyle = std::move(cs);
+    setDirty();
+  }
+
+  m_styleParentGeneration = parentGeneration;
+  bStyleDirty = false;
+}
+
 /**
 \internal
 
@@ -2187,12 +3588,10 @@ void viewManager::Element::updateIndexBy(const indexBy &setting) {
   // map
   std::string oldKey = "";
   const std::string &newKey = setting.value;
-  auto it = attributes.find(std::type_index(typeid(indexBy)));
 
   // get the key of the old id
-  if (it != attributes.end()) {
-    oldKey = std::any_cast<indexBy>(it->second).value;
-  }
+  if (indexBy *old = attributes.find<indexBy>())
+    oldKey = old->value;
 
   // case a. key is not blank,
   // yet it is the same value
@@ -2265,6 +3664,7 @@ auto viewManager::Element::insertBefore(Element &newChild,
     m_firstChild = child.m_self;
   }
   m_childCount++;
+  child.setDirty();
   return child;
 }
 
@@ -2314,6 +3714,7 @@ auto viewManager::Element::insertAfter(Element &newChild,
     m_lastChild = newChild.m_self;
   }
   m_childCount++;
+  newChild.setDirty();
   return newChild;
 }
 
@@ -2367,16 +3768,14 @@ auto viewManager::Element::replaceChild(Element &newChild, Element &oldChild)
     oldChild.m_nextSibling->m_previousSibling = newChild.m_self;
 
   newChild.m_parent = oldChild.m_parent;
+  newChild.setDirty();
 
   // remove reference from string id indexed list
-  try {
-    indexedElements.erase(oldChild.getAttribute<indexBy>().value);
-
-  } catch (const std::exception &e) {
-    // std::cout << " Exception: " << e.what() << "\n";
-  }
+  if (indexBy *id = oldChild.tryGetAttribute<indexBy>())
+    indexedElements.erase(id->value);
 
   // remove the element smart pointer
+  oldChild.releasePainting();
   auto it = elements.find((std::size_t)oldChild.m_self);
   if (it != elements.end())
     elements.erase(it);
@@ -2398,6 +3797,8 @@ Example
 auto viewManager::Element::move(const double t, const double l) -> Element & {
   getAttribute<objectTop>().value = t;
   getAttribute<objectLeft>().value = l;
+  setDirty();
+  bStyleDirty = true;
   return *this;
 }
 
@@ -2415,6 +3816,8 @@ Example
 auto viewManager::Element::resize(const double w, const double h) -> Element & {
   getAttribute<objectWidth>().value = w;
   getAttribute<objectHeight>().value = h;
+  setDirty();
+  bStyleDirty = true;
   return *this;
 }
 
@@ -2448,15 +3851,16 @@ void viewManager::Element::remove(void) {
   if (m_previousSibling)
     m_previousSibling->m_nextSibling = m_nextSibling;
 
-  // remove reference from string id indexed list
-  try {
-    indexedElements.erase(getAttribute<indexBy>().value);
+  // the following siblings move, so the parent is laid out again.
+  if (m_parent)
+    m_parent->setChildDirty();
 
-  } catch (const std::exception &e) {
-    // std::cout << " Exception: " << e.what() << "\n";
-  }
+  // remove reference from string id indexed list
+  if (indexBy *id = tryGetAttribute<indexBy>())
+    indexedElements.erase(id->value);
 
   // free smart pointer
+  releasePainting();
   auto it = elements.find((std::size_t)m_self);
   if (it != elements.end())
     elements.erase(it);
@@ -2530,19 +3934,17 @@ auto viewManager::Element::removeChild(Element &oldChild) -> Element & {
     oldChild.m_nextSibling->m_previousSibling = oldChild.m_previousSibling;
 
   // update string index list
-  try {
-    indexedElements.erase(oldChild.getAttribute<indexBy>().value);
-
-  } catch (const std::exception &e) {
-    // std::cout << " Exception: " << e.what() << "\n";
-  }
+  if (indexBy *id = oldChild.tryGetAttribute<indexBy>())
+    indexedElements.erase(id->value);
 
   // free memory
+  oldChild.releasePainting();
   auto it = elements.find((std::size_t)oldChild.m_self);
   if (it != elements.end())
     elements.erase(it);
 
   m_childCount--;
+  setChildDirty();
   return *this;
 }
 
@@ -2568,14 +3970,11 @@ auto viewManager::Element::removeChildren(void) -> Element & {
       pItem->removeChildren();
 
     // update string index list
-    try {
-      indexedElements.erase(pItem->getAttribute<indexBy>().value);
-
-    } catch (const std::exception &e) {
-      // std::cout << " Exception: " << e.what() << "\n";
-    }
+    if (indexBy *id = pItem->tryGetAttribute<indexBy>())
+      indexedElements.erase(id->value);
 
     // free memory
+    pItem->releasePainting();
     pItem = pItem->m_nextSibling;
     auto it = elements.find(storageKey);
     if (it != elements.end())
@@ -2586,6 +3985,7 @@ auto viewManager::Element::removeChildren(void) -> Element & {
   m_firstChild = nullptr;
   m_lastChild = nullptr;
   m_childCount = 0;
+  setChildDirty();
 
   return *this;
 }
@@ -2610,6 +4010,7 @@ auto viewManager::Element::clear(void) -> Element & {
     n = m_usageAdaptorMap.erase(n);
 
   removeChildren();
+  setDirty();
   return *this;
 }
 
@@ -2732,31 +4133,24 @@ routine stores the results in an unordered_map indexed by the typeid.
 A vector of std::size_t notes the index position within the string
 where the space is.
 */
-void viewManager::Element::wordMetrics(Visualizer::platform &device) {
+void viewManager::Element::wordMetrics(Visualizer::fontContext &fonts,
+                                       FTC_FaceID faceID) {
   // -- optimizations can be made here
   // caching the stream
   // caching the word breaks.
-  string stextface;
-  double dsize;
-
-  // get the textface and point size that is used for the element's
-  // data
-  try {
-    stextface = getAttribute<textFace>().value;
-  } catch (exception e) {
-    stextface = DEFAULT_TEXTFACE;
-  }
 
-  try {
-    dsize = getAttribute<textSize>().toPt();
-  } catch (exception e) {
-    dsize = DEFAULT_TEXTSIZE;
-  }
+  // the point size that is used for the element's data. The face id is
+  // resolved from the computed style by the caller.
+  double dsize = computedStyle.textSize;
+  textFaceHeight = fonts.measureFaceHeight(faceID, dsize);
+  bEstimatedMetrics = false;
+  retainedWrapWidth = -1;
+  lineBoxWidth = -1;
   size_t storageTypeID;
   // find all word breaks within the string
   indexedWordMetrics.erase(indexedWordMetrics.begin(),
                            indexedWordMetrics.end());
-  for (auto m : m_usageAdaptorMap) {
+  for (auto &m : m_usageAdaptorMap) {
     size_t textDataSize = 0;
 
     // get the number of elements
@@ -2784,7 +4178,7 @@ void viewManager::Element::wordMetrics(Visualizer::platform &device) {
     // iterate the data within the element,
     // get both the size of the rendered field and
     for (std::size_t idx = 0; idx < textDataSize; idx++) {
-      string s;
+      std::string_view s;
 
       if (m.first == typeid(vector<string>)) {
         auto &o = any_cast<usageAdaptor<string> &>(m.second);
@@ -2803,25 +4197,25 @@ void viewManager::Element::wordMetrics(Visualizer::platform &device) {
       // build a tuple vector contains the totaling width as the string
       // progresses including the space, the width of the text without a space,
       // and the position of the space within the text
+      // the words are measured through the word cache of the context.
       vector<wordMetricType> positions;
-      size_t pos = s.find_first_of(" \n\t");
+      std::string_view sv = s;
+      size_t pos = sv.find_first_of(" \n\t");
       size_t begin = 0;
       double dtotal = 0;
-      string text;
       double width;
-      double dspacesize = device.measureTextWidth(stextface, dsize, " ");
-      while (pos != s.npos) {
-        text = s.substr(begin, pos - begin);
-        width = device.measureTextWidth(stextface, dsize, text);
+      double dspacesize = fonts.measureWordWidth(faceID, dsize, " ");
+      while (pos != sv.npos) {
+        width = fonts.measureWordWidth(faceID, dsize,
+                                       sv.substr(begin, pos - begin));
         dtotal += width + dspacesize;
         positions.push_back({dtotal, width, pos});
         begin = pos + 1;
-        pos = s.find_first_of(" \n\t", begin);
+        pos = sv.find_first_of(" \n\t", begin);
       }
 
       // handle last part of string
-      text = s.substr(begin);
-      width = device.measureTextWidth(stextface, dsize, text);
+      width = fonts.measureWordWidth(faceID, dsize, sv.substr(begin));
       dtotal += width + dspacesize;
       positions.push_back({dtotal, width, pos});
 
@@ -2830,6 +4224,94 @@ void viewManager::Element::wordMetrics(Visualizer::platform &device) {
   }
 }
 
+/**
+\internal
+\brief The routine provides the metrics of an element that is far from the
+viewport without measuring its words. Each line of data receives one entry
+whose width is the number of characters times the average advance of the
+face. The word breaks are measured once the element comes near.
+*/
+void viewManager::Element::estimateWordMetrics(const double dAverageAdvance,
+                                               const double dFaceHeight) {
+  textFaceHeight = dFaceHeight;
+  bEstimatedMetrics = true;
+  retainedWrapWidth = -1;
+  lineBoxWidth = -1;
+  size_t storageTypeID;
+  indexedWordMetrics.erase(indexedWordMetrics.begin(),
+                           indexedWordMetrics.end());
+  for (auto &m : m_usageAdaptorMap) {
+    size_t textDataSize = 0;
+
+    // get the number of elements
+    if (m.first == typeid(vector<string>)) {
+      storageTypeID = m.first.hash_code();
+      auto &o = any_cast<usageAdaptor<string> &>(m.second);
+      textDataSize = o.textDataSize();
+
+    } else if (m.first == typeid(vector<double>)) {
+      storageTypeID = m.first.hash_code();
+      auto &o = any_cast<usageAdaptor<double> &>(m.second);
+      textDataSize = o.textDataSize();
+
+    } else if (m.first == typeid(vector<float>)) {
+      storageTypeID = m.first.hash_code();
+      auto &o = any_cast<usageAdaptor<float> &>(m.second);
+      textDataSize = o.textDataSize();
+
+    } else if (m.first == typeid(vector<int>)) {
+      storageTypeID = m.first.hash_code();
+      auto &o = any_cast<usageAdaptor<int> &>(m.second);
+      textDataSize = o.textDataSize();
+    }
+
+    for (std::size_t idx = 0; idx < textDataSize; idx++) {
+      size_t length = 0;
+
+      if (m.first == typeid(vector<string>)) {
+        auto &o = any_cast<usageAdaptor<string> &>(m.second);
+        length = o.textData(idx).size();
+      } else if (m.first == typeid(vector<double>)) {
+        auto &o = any_cast<usageAdaptor<double> &>(m.second);
+        length = o.textData(idx).size();
+      } else if (m.first == typeid(vector<float>)) {
+        auto &o = any_cast<usageAdaptor<float> &>(m.second);
+        length = o.textData(idx).size();
+      } else if (m.first == typeid(vector<int>)) {
+        auto &o = any_cast<usageAdaptor<int> &>(m.second);
+        length = o.textData(idx).size();
+      }
+
+      double width = (length + 1) * dAverageAdvance;
+      indexedWordMetrics[{storageTypeID, idx}] = {{width, width, string::npos}};
+    }
+  }
+
+  // without text, there is nothing to measure later.
+  bEstimatedMetrics = !indexedWordMetrics.empty();
+}
+
+/**
+\internal
+\brief The routine releases the word breaks of an element that has moved
+far from the viewport. The width of each line is kept as its only entry,
+so the widest line and the wrapped height at the same width are unchanged.
+*/
+void viewManager::Element::evictWordMetrics(void) {
+  if (bEstimatedMetrics)
+    return;
+
+  for (auto &n : indexedWordMetrics) {
+    if (n.second.size() < 2)
+      continue;
+    double width = n.second.back().totalWidth;
+    n.second = {{width, width, string::npos}};
+  }
+  std::vector<lineBoxType>().swap(lineBoxes);
+  lineBoxWidth = -1;
+  bEstimatedMetrics = true;
+}
+
 /**
 \internal
 \brief The routine finds the largest string within the group of data elements.
@@ -2839,8 +4321,8 @@ viewManager::Element::computeWidestTextData(Visualizer::platform &device) {
   double dMaxWidth = 0;
   size_t storageTypeID;
 
-  for (auto m : m_usageAdaptorMap) {
-    size_t textDataSize;
+  for (auto &m : m_usageAdaptorMap) {
+    size_t textDataSize = 0;
     // get the size of the amount of data
     if (m.first == typeid(std::vector<std::string>)) {
       storageTypeID = m.first.hash_code();
@@ -2866,17 +4348,13 @@ viewManager::Element::computeWidestTextData(Visualizer::platform &device) {
     // iterate the word Metrics
     for (size_t idx = 0; idx < textDataSize; idx++) {
 
-      // find the textual layout positions for wrapping
-      vector<wordMetricType> lineWordMetrics;
+      // the widest line is the total of its last word.
       auto it = indexedWordMetrics.find({storageTypeID, idx});
-      if (it != indexedWordMetrics.end()) {
-        lineWordMetrics = it->second;
-      }
+      if (it == indexedWordMetrics.end() || it->second.empty())
+        continue;
 
-      // if the line will fit within the defined rectangle, show it without
-      // searching
-      if (dMaxWidth <= lineWordMetrics.back().totalWidth)
-        dMaxWidth = lineWordMetrics.back().totalWidth;
+      if (dMaxWidth <= it->second.back().totalWidth)
+        dMaxWidth = it->second.back().totalWidth;
     }
   }
   return dMaxWidth;
@@ -2885,45 +4363,44 @@ viewManager::Element::computeWidestTextData(Visualizer::platform &device) {
 /**
 \internal
 \brief The routine performs a virtual wrapping of the textual data based
-upon the contents of the information.
+upon the contents of the information. The line boxes that are built are
+kept for painting.
 */
 double
-viewManager::Element::computeWrappedTextDataHeight(Visualizer::platform &device,
-                                                   double dWrappingWidth) {
-  string sTextFace;
-  int tSize;
-  double dFaceHeight;
-  double dLineHeight;
-  double dTextLineHeight;
-  size_t linesDisplayed = 0;
+viewManager::Element::computeWrappedTextDataHeight(double dWrappingWidth) {
+  // the height of the last measure holds while the width is the same.
+  if (bEstimatedMetrics && dWrappingWidth == retainedWrapWidth)
+    return retainedTextHeight;
 
-  try {
-    sTextFace = getAttribute<textFace>().value;
-  } catch (const std::exception &e) {
-    sTextFace = DEFAULT_TEXTFACE;
-  }
+  computeLineBoxes(dWrappingWidth);
 
-  try {
-    auto v = getAttribute<textSize>().toPt();
-    tSize = static_cast<int>(v);
-  } catch (const std::exception &e) {
-    tSize = DEFAULT_TEXTSIZE;
+  if (!bEstimatedMetrics) {
+    retainedWrapWidth = dWrappingWidth;
+    retainedTextHeight = lineBoxHeight;
   }
+  return lineBoxHeight;
+}
+
+/**
+\internal
+\brief The routine wraps the textual data at the given width, producing
+the line boxes. Each box notes the range of characters of one line of a
+data string, its width and its offset from the top of the element. The
+boxes are kept until the width or the word metrics change.
+*/
+void viewManager::Element::computeLineBoxes(double dWrappingWidth) {
+  if (dWrappingWidth == lineBoxWidth)
+    return;
 
   // adjust the textline height to pixel values for advancement.
   // the lineheight is given in a decimal range.
-  dLineHeight = 1.0;
-  try {
-    auto lh = getAttribute<lineHeight>();
-    if (lh.option == lineHeight::normal)
-      dLineHeight = lh.value;
-  } catch (std::exception e) {
-  }
-  dFaceHeight = device.measureFaceHeight(sTextFace, tSize);
-  dTextLineHeight = dFaceHeight * dLineHeight;
+  double dTextLineHeight = textFaceHeight * computedStyle.lineHeight;
+  size_t linesDisplayed = 0;
+
+  lineBoxes.clear();
   size_t storageTypeID;
-  for (auto m : m_usageAdaptorMap) {
-    size_t textDataSize;
+  for (auto &m : m_usageAdaptorMap) {
+    size_t textDataSize = 0;
     // get the size of the amount of data
     if (m.first == typeid(std::vector<std::string>)) {
       storageTypeID = m.first.hash_code();
@@ -2950,45 +4427,72 @@ viewManager::Element::computeWrappedTextDataHeight(Visualizer::platform &device,
     for (size_t idx = 0; idx < textDataSize; idx++) {
 
       // find the textual layout positions for wrapping
-      vector<wordMetricType> lineWordMetrics;
       auto it = indexedWordMetrics.find({storageTypeID, idx});
-      if (it != indexedWordMetrics.end()) {
-        lineWordMetrics = it->second;
-      }
+      if (it == indexedWordMetrics.end() || it->second.empty())
+        continue;
+      const vector<wordMetricType> &lineWordMetrics = it->second;
+      double dLineWidth = lineWordMetrics.back().totalWidth;
+
+      auto addLine = [&](size_t begin, size_t end, double width) {
+        lineBoxes.push_back({storageTypeID, idx, begin, end, width,
+                             linesDisplayed * dTextLineHeight});
+        linesDisplayed++;
+      };
 
       // if the line will fit within the defined rectangle, show it without
       // searching
-      if (dWrappingWidth >= lineWordMetrics.back().totalWidth) {
-        linesDisplayed++;
+      if (dWrappingWidth >= dLineWidth) {
+        addLine(0, string::npos, dLineWidth);
+
+      } else if (bEstimatedMetrics) {
+        // the estimate fills each line completely. The text is wrapped
+        // while it is drawn.
+        size_t lines =
+            dWrappingWidth > 0
+                ? static_cast<size_t>(std::ceil(dLineWidth / dWrappingWidth))
+                : 1;
+        addLine(0, string::npos, dWrappingWidth);
+        linesDisplayed += lines - 1;
+
       } else {
         // find the width that can be drawn within the given rectangle of text.
         // and break apart the text into line wrapping.
+        const wordMetricType *lastMetric = &lineWordMetrics[0];
+        size_t lastCharacterRendered = 0;
         double dConsumedSpace = 0;
         double dTotalConsumedSpace = 0;
         for (auto &n : lineWordMetrics) {
           if (n.totalWidth - dTotalConsumedSpace > dWrappingWidth) {
+            // the piece of text that is calculated to fit within the
+            // bounds.
+            addLine(lastCharacterRendered,
+                    std::max(lastCharacterRendered, lastMetric->spacePosition),
+                    dConsumedSpace);
 
             // accumulate the total amount of horizontal space within the
             // string that has been rendered.
             dTotalConsumedSpace = dTotalConsumedSpace + dConsumedSpace;
             dConsumedSpace = 0;
-            linesDisplayed++;
+            lastCharacterRendered = lastMetric->spacePosition + 1;
 
             // display last part of unbroken contigious string, last time
             // processing
-            if (lineWordMetrics.back().totalWidth - dTotalConsumedSpace <=
-                displayList.ow) {
-              linesDisplayed++;
+            if (dLineWidth - dTotalConsumedSpace <= dWrappingWidth) {
+              addLine(lastCharacterRendered, string::npos,
+                      dLineWidth - dTotalConsumedSpace);
               break;
             }
           }
 
           dConsumedSpace = n.totalWidth - dTotalConsumedSpace;
+          lastMetric = &n;
         }
       }
     }
   }
-  return linesDisplayed * dTextLineHeight;
+
+  lineBoxWidth = dWrappingWidth;
+  lineBoxHeight = linesDisplayed * dTextLineHeight;
 }
 
 /**
@@ -2998,58 +4502,40 @@ its children. It is called recursively when painting needs to occur.
 This function is used internally and is not necessary to invoke. That
 is, system already invokes this as part of the processing stack. The
 work performed by this routine is accomplished using the surface image.
+The box of the element is painted first, its background and border.
+The lines are drawn from the line boxes of the element's width, and are
+submitted to the device together so the font is resolved once.
 */
 void viewManager::Element::render(Visualizer::platform &device) {
-  string sTextFace;
-  int tSize;
-  int tColor;
-  textAlignment tAlign = textAlignment(textAlignment::left);
-  double dFaceHeight;
-  double dLineHeight;
-  double dTextLineHeight;
-
-  try {
-    sTextFace = getAttribute<textFace>().value;
-  } catch (const std::exception &e) {
-    sTextFace = DEFAULT_TEXTFACE;
-  }
-
-  try {
-    auto v = getAttribute<textSize>().toPt();
-    tSize = static_cast<int>(v);
-  } catch (const std::exception &e) {
-    tSize = DEFAULT_TEXTSIZE;
-  }
-
-  try {
-    array<double, 4> tc = getAttribute<textColor>().value;
-    tColor = (static_cast<int>(tc[0]) << 16) | (static_cast<int>(tc[1]) << 8) |
-             static_cast<int>(tc[2]);
-  } catch (const std::exception &e) {
-    tColor = DEFAULT_TEXTCOLOR;
-  }
-
-  try {
-    tAlign = getAttribute<textAlignment>();
-  } catch (const std::exception &e) {
-    tAlign = textAlignment::left;
-  }
+  const string &sTextFace = computedStyle.textFace;
+  int tSize = static_cast<int>(computedStyle.textSize);
+  unsigned int tColor = computedStyle.textColor;
+
+  bool bBorder = computedStyle.border != borderStyle::none &&
+                 computedStyle.borderWidth > 0;
+  if ((computedStyle.bBackground || bBorder) && computedStyle.opacity > 0)
+    device.drawBox(
+        {static_cast<int>(std::round(displayList.x1)),
+         static_cast<int>(std::round(displayList.y1)),
+         static_cast<int>(std::round(displayList.x2)),
+         static_cast<int>(std::round(displayList.y2)),
+         computedStyle.bBackground, computedStyle.background,
+         bBorder ? computedStyle.border : borderStyle::none,
+         static_cast<int>(std::round(computedStyle.borderWidth)),
+         computedStyle.borderColor,
+         static_cast<int>(std::round(computedStyle.borderRadius)),
+         static_cast<unsigned int>(std::round(computedStyle.opacity * 255))});
+
+  computeLineBoxes(displayList.ow);
+  auto box = lineBoxes.begin();
+
+  // the lines refer to the text held by the data adaptors.
+  std::vector<Visualizer::platform::textLine> lines;
+  lines.reserve(lineBoxes.size());
 
-  // adjust the textline height to pixel values for advancement.
-  // the lineheight is given in a decimal range.
-  dLineHeight = 1.0;
-  try {
-    auto lh = getAttribute<lineHeight>();
-    if (lh.option == lineHeight::normal)
-      dLineHeight = lh.value;
-  } catch (std::exception e) {
-  }
-  dFaceHeight = device.measureFaceHeight(sTextFace, tSize);
-  dTextLineHeight = dFaceHeight * dLineHeight;
   size_t storageTypeID;
-
-  for (auto m : m_usageAdaptorMap) {
-    size_t textDataSize;
+  for (auto &m : m_usageAdaptorMap) {
+    size_t textDataSize = 0;
     // get the size of the amount of data
     if (m.first == typeid(std::vector<std::string>)) {
       storageTypeID = m.first.hash_code();
@@ -3072,11 +4558,14 @@ void viewManager::Element::render(Visualizer::platform &device) {
       textDataSize = o.textDataSize();
     }
 
-    // iterate the strings within the data
-    size_t linesDisplayed = 0;
+    // iterate the strings within the data, the line boxes are in the
+    // same order.
     for (size_t idx = 0; idx < textDataSize; idx++) {
-      string s;
+      if (box == lineBoxes.end() || box->storageTypeID != storageTypeID ||
+          box->index != idx)
+        continue;
 
+      std::string_view s;
       if (m.first == typeid(std::vector<std::string>)) {
         auto &o = std::any_cast<usageAdaptor<std::string> &>(m.second);
         s = o.textData(idx);
@@ -3091,74 +4580,24 @@ void viewManager::Element::render(Visualizer::platform &device) {
         s = o.textData(idx);
       }
 
-      // find the textual layout positions for wrapping
-      vector<wordMetricType> lineWordMetrics;
-      auto it = indexedWordMetrics.find({storageTypeID, idx});
-      if (it != indexedWordMetrics.end()) {
-        lineWordMetrics = it->second;
-      }
+      std::string_view sv = s;
+      for (; box != lineBoxes.end() && box->storageTypeID == storageTypeID &&
+             box->index == idx;
+           box++) {
+        size_t begin = std::min(box->begin, sv.size());
 
-      // if the line will fit within the defined rectangle, show it without
-      // searching
-      if (displayList.ow >= lineWordMetrics.back().totalWidth) {
         // draw within the calculated layout rectangle.
-        device.drawText(sTextFace, tSize, s, tColor, displayList.x1,
-                        displayList.y1 + idx * dTextLineHeight, displayList.x2,
-                        displayList.y2, tAlign);
-      } else {
-        // find the width that can be drawn within the given rectangle of text.
-        // and break apart the text into line wrapping.
-        bool bDone = false;
-        double dyPos = displayList.y1;
-        wordMetricType lastMetric=lineWordMetrics[0];
-        size_t lastCharacterRendered = 0;
-        string sText;
-        double dConsumedSpace = 0;
-        double dTotalConsumedSpace = 0;
-        for (auto &n : lineWordMetrics) {
-          if (n.totalWidth - dTotalConsumedSpace > displayList.ow) {
-            // get the piece of text that is calculate to fit within the
-            // bounds.
-            sText = s.substr(lastCharacterRendered,
-                             lastMetric.spacePosition - lastCharacterRendered);
-
-            // draw within the calculated layout rectangle.
-            device.drawText(sTextFace, tSize, sText, tColor, displayList.x1,
-                            displayList.y1 + linesDisplayed * dTextLineHeight,
-                            displayList.x2, displayList.y2, tAlign);
-
-            // accumulate the total amount of horizontal space within the
-            // string that has been rendered.
-            dTotalConsumedSpace = dTotalConsumedSpace + dConsumedSpace;
-            dConsumedSpace = 0;
-            lastCharacterRendered = lastMetric.spacePosition + 1;
-            linesDisplayed++;
-
-            // display last part of unbroken contigious string, last time
-            // processing
-            if (lineWordMetrics.back().totalWidth - dTotalConsumedSpace <=
-                displayList.ow) {
-              sText =
-                  s.substr(lastCharacterRendered,
-                           lastMetric.spacePosition - lastCharacterRendered);
-
-              // draw within the calculated layout rectangle.
-              device.drawText(sTextFace, tSize, sText, tColor, displayList.x1,
-                              displayList.y1 + linesDisplayed * dTextLineHeight,
-                              displayList.x2, displayList.y2, tAlign);
-              linesDisplayed++;
-
-              lastMetric = lineWordMetrics.back();
-              break;
-            }
-          }
-
-          dConsumedSpace = n.totalWidth - dTotalConsumedSpace;
-          lastMetric = n;
-        }
+        lines.push_back({sv.substr(begin, box->end - begin),
+                         static_cast<int>(displayList.x1),
+                         static_cast<int>(displayList.y1 + box->y),
+                         static_cast<int>(displayList.x2),
+                         static_cast<int>(displayList.y2)});
       }
     }
   }
+
+  if (!lines.empty())
+    device.drawTextLines(sTextFace, tSize, tColor, lines);
 }
 
 /**
@@ -3541,12 +4980,22 @@ viewManager::Visualizer::platform::platform(const eventHandler &evtDispatcher,
   _w = width;
   _h = height;
   fontScale = 0;
+  m_bHeadless = false;
+  m_bRecording = false;
+  m_originX = 0;
+  m_originY = 0;
+  m_pixels = nullptr;
+  resetClip();
 
 // initialize private members
 #if defined(__linux__)
   m_connection = nullptr;
   m_screen = nullptr;
   m_window = 0;
+  m_images = {};
+  m_bSharedMemory = false;
+  m_back = 0;
+  m_completionEvent = 0;
   m_syms = nullptr;
   m_foreground = 0;
 
@@ -3607,10 +5056,14 @@ viewManager::Visualizer::platform::~platform() {
 #endif
 
 #if defined(__linux__)
-  xcb_shm_detach(m_connection, m_info.shmseg);
-  shmdt(m_info.shmaddr);
+  // a headless surface has no connection.
+  if (!m_connection)
+    return;
+
+  releaseImages();
+  for (auto e : m_pendingEvents)
+    free(e);
 
-  xcb_free_pixmap(m_connection, m_pix);
   xcb_free_gc(m_connection, m_foreground);
   xcb_key_symbols_free(m_syms);
 
@@ -3653,10 +5106,10 @@ void viewManager::Visualizer::platform::openWindow(
   m_window = xcb_generate_id(m_connection);
   mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
   values[0] = m_screen->white_pixel;
-  values[1] = XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_KEY_PRESS |
-              XCB_EVENT_MASK_KEY_RELEASE | XCB_EVENT_MASK_POINTER_MOTION |
-              XCB_EVENT_MASK_BUTTON_MOTION | XCB_EVENT_MASK_BUTTON_PRESS |
-              XCB_EVENT_MASK_BUTTON_RELEASE;
+  values[1] = XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_STRUCTURE_NOTIFY |
+              XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_KEY_RELEASE |
+              XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_BUTTON_MOTION |
+              XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE;
 
   xcb_create_window(
       m_connection, XCB_COPY_FROM_PARENT, m_window, m_screen->root, 0, 0,
@@ -3752,6 +5205,54 @@ void viewManager::Visualizer::platform::terminateVideo(void) {
 
 
 */
+/**
+  \internal
+  \brief prepares the offscreen buffer as the only surface, without a
+  window or display. The layout and rasterizing are the same as when a
+  window is open, flip does not copy the buffer anywhere.
+*/
+void viewManager::Visualizer::platform::openHeadless(void) {
+  m_bHeadless = true;
+  resize(_w, _h);
+}
+
+/**
+  \internal
+  \brief writes the offscreen buffer to a binary portable pixmap, PPM,
+  file.
+*/
+void viewManager::Visualizer::platform::writeImage(
+    const std::string &sFilename) {
+  std::ofstream file(sFilename, std::ios::binary);
+  if (!file)
+    throw std::runtime_error("Could not open the image file for writing.");
+
+  file << "P6\n" << _w << " " << _h << "\n255\n";
+
+  // with a window, the last frame drawn is the image shown.
+  const u_int8_t *pixels = m_pixels;
+#if defined(__linux__)
+  if (m_bSharedMemory)
+    pixels = m_images[1 - m_back].info.shmaddr;
+#endif
+
+  // the pixels are stored as 0x00RRGGBB.
+  std::vector<char> row(_w * 3);
+  for (int y = 0; y < _h; y++) {
+    const unsigned int *p =
+        reinterpret_cast<const unsigned int *>(&pixels[y * _w * 4]);
+    for (int x = 0; x < _w; x++) {
+      row[x * 3] = static_cast<char>(p[x] >> 16);
+      row[x * 3 + 1] = static_cast<char>(p[x] >> 8);
+      row[x * 3 + 2] = static_cast<char>(p[x]);
+    }
+    file.write(row.data(), row.size());
+  }
+
+  if (!file)
+    throw std::runtime_error("Could not write the image file.");
+}
+
 void viewManager::Visualizer::platform::closeWindow(void) {
 #if defined(__linux__)
 
@@ -3895,10 +5396,26 @@ operating system. The function is called from processEvents.
 
 */
 void viewManager::Visualizer::platform::messageLoop(void) {
+  // without a display, there are no events.
+  if (m_bHeadless)
+    return;
+
 #if defined(__linux__)
   xcb_generic_event_t *xcbEvent;
 
-  while ((xcbEvent = xcb_wait_for_event(m_connection))) {
+  while ((xcbEvent = nextEvent())) {
+    // the server is done with an image sent before.
+    if (m_bSharedMemory &&
+        (xcbEvent->response_type & ~0x80) == m_completionEvent) {
+      auto *completion = reinterpret_cast<xcb_shm_completion_event_t *>(
+          xcbEvent);
+      for (auto &image : m_images)
+        if (image.info.shmseg == completion->shmseg && image.pending)
+          image.pending--;
+      free(xcbEvent);
+      continue;
+    }
+
     switch (xcbEvent->response_type & ~0x80) {
     case XCB_MOTION_NOTIFY: {
       xcb_motion_notify_event_t *motion = (xcb_motion_notify_event_t *)xcbEvent;
@@ -3948,7 +5465,20 @@ void viewManager::Visualizer::platform::messageLoop(void) {
       dispatchEvent(event{eventType::keyup, sym});
     } break;
     case XCB_EXPOSE: {
-      flip();
+      // the last frame is sent once for the series of exposed areas.
+      xcb_expose_event_t *ex = (xcb_expose_event_t *)xcbEvent;
+      if (ex->count == 0)
+        flip();
+    } break;
+    case XCB_CONFIGURE_NOTIFY: {
+      // the event notes moves as well, only a change of size is drawn.
+      xcb_configure_notify_event_t *cn =
+          (xcb_configure_notify_event_t *)xcbEvent;
+      if (cn->width != _w || cn->height != _h) {
+        dispatchEvent(event{eventType::resize, static_cast<short>(cn->width),
+                            static_cast<short>(cn->height)});
+        dispatchEvent(event{eventType::paint});
+      }
     } break;
     }
     free(xcbEvent);
@@ -3978,45 +5508,133 @@ FT_Error viewManager::Visualizer::platform::faceRequestor(
     FT_Face *aface) {
   FT_Error error;
   faceCacheStruct *fID = static_cast<faceCacheStruct *>(face_id);
+
+#if defined(__linux__)
+  // the face is opened from the mapping of its file, which is released
+  // by the finalizer of the face when the cache manager closes it.
+  mappedFontFiles::mappedFile *file = mappedFonts.acquire(fID->filePath);
+  if (!file)
+    return FT_Err_Cannot_Open_Resource;
+
+  error = FT_New_Memory_Face(library, file->data,
+                             static_cast<FT_Long>(file->size), 0, aface);
+  if (error) {
+    mappedFonts.release(file);
+    return error;
+  }
+
+  (*aface)->generic.data = file;
+  (*aface)->generic.finalizer = [](void *object) {
+    FT_Face face = static_cast<FT_Face>(object);
+    mappedFonts.release(
+        static_cast<mappedFontFiles::mappedFile *>(face->generic.data));
+  };
+
+#else
   error = FT_New_Face(library, fID->filePath.data(), 0, aface);
+  if (error)
+    return error;
+
+#endif
 
   // we want to use unicode
   error = FT_Select_Charmap(*aface, FT_ENCODING_UNICODE);
 
   return error;
 }
+#if defined(__linux__)
+viewManager::Visualizer::fontResolver viewManager::Visualizer::fontFiles;
+
+viewManager::Visualizer::fontResolver::fontResolver()
+    : m_config(nullptr), m_bIndexRead(false) {}
+
 /**
 \internal
-\brief The function provides the building and location of a textFace name
-The function independently works on linux vs. windows. The linux is much
-more advanced in that it uses the fontconfig api. This api provides for
-family matching as a browser would incorporate. Whereas the windows portion
-uses the registry access and simply compares a string.
+\brief waits for the faces being resolved at startup and releases the
+fontconfig configuration.
+*/
+viewManager::Visualizer::fontResolver::~fontResolver() {
+  if (m_prewarm.valid())
+    m_prewarm.wait();
+  if (m_config)
+    FcConfigDestroy(m_config);
+}
 
-The function comes from the following source:
-https://stackoverflow.com/questions/10542832/how-to-use-fontconfig-to-get-font-list-c-c
-https://stackoverflow.com/questions/3954223/platform-independent-way-to-get-font-directory
+/**
+\internal
+\brief returns the font file of the textFace name. The names are resolved
+once for the process, and those within a valid index file are not resolved
+again.
+*/
+std::string
+viewManager::Visualizer::fontResolver::filename(const std::string &sTextFace) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_bIndexRead)
+    readIndex();
+
+  auto it = m_files.find(sTextFace);
+  if (it != m_files.end())
+    return it->second;
+
+  std::string sFilename = resolve(sTextFace);
+  m_files[sTextFace] = sFilename;
+  writeIndex();
+  return sFilename;
+}
 
-\param sTextFace
+/**
+\internal
+\brief resolves the font files of the names on another thread. A name
+that is requested while it is being resolved waits for it. The
+configuration is built by this thread when one of the names is not within
+the index.
+*/
+void viewManager::Visualizer::fontResolver::prewarm(
+    const std::vector<std::string> &faces) {
+  if (m_prewarm.valid())
+    m_prewarm.wait();
+  m_prewarm = std::async(std::launch::async, [this, faces]() {
+    for (auto &n : faces)
+      filename(n);
+  });
+}
 
+/**
+\internal
+\brief matches the name using fontconfig. This family matching is as a
+browser would incorporate. The configuration is built the first time and
+the font directories it scanned are noted for the index.
+
+The function comes from the following source:
+https://stackoverflow.com/questions/10542832/how-to-use-fontconfig-to-get-font-list-c-c
 */
-std::string viewManager::Visualizer::platform::getFontFilename(
-    const std::string &sTextFace) {
+std::string
+viewManager::Visualizer::fontResolver::resolve(const std::string &sTextFace) {
   std::string fontFileReturn;
 
-#if defined(__linux__)
-
-  FcConfig *config = FcInitLoadConfigAndFonts();
+  if (!m_config) {
+    m_config = FcInitLoadConfigAndFonts();
+    if (!m_config)
+      return fontFileReturn;
+
+    m_directories.clear();
+    FcStrList *dirs = FcConfigGetFontDirs(m_config);
+    if (dirs) {
+      FcChar8 *dir;
+      while ((dir = FcStrListNext(dirs)))
+        m_directories[(const char *)dir] = modified((const char *)dir);
+      FcStrListDone(dirs);
+    }
+  }
 
   // configure the search pattern,
-  // assume "name" is a std::string with the desired font name in it
   FcPattern *pat = FcNameParse((const FcChar8 *)(sTextFace.c_str()));
-  FcConfigSubstitute(config, pat, FcMatchPattern);
+  FcConfigSubstitute(m_config, pat, FcMatchPattern);
   FcDefaultSubstitute(pat);
 
   // find the font
   FcResult ret;
-  FcPattern *font = FcFontMatch(config, pat, &ret);
+  FcPattern *font = FcFontMatch(m_config, pat, &ret);
   if (font) {
     FcChar8 *file = NULL;
     if (FcPatternGetString(font, FC_FILE, 0, &file) == FcResultMatch) {
@@ -4027,6 +5645,228 @@ std::string viewManager::Visualizer::platform::getFontFilename(
   }
 
   FcPatternDestroy(pat);
+  return fontFileReturn;
+}
+
+/**
+\internal
+\brief the modification time of the directory. A directory that does not
+exist is noted as -1, so creating it later is seen as a change.
+*/
+std::pair<long, long> viewManager::Visualizer::fontResolver::modified(
+    const std::string &sDirectory) {
+  struct stat info;
+  if (stat(sDirectory.data(), &info) != 0)
+    return {-1, -1};
+  return {info.st_mtim.tv_sec, info.st_mtim.tv_nsec};
+}
+
+/**
+\internal
+\brief the name of the index file, within XDG_CACHE_HOME or the .cache
+directory of the user. An empty string when neither is known.
+*/
+std::string viewManager::Visualizer::fontResolver::indexFilename(void) {
+  std::string sDirectory;
+  const char *cache = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  if (cache && *cache)
+    sDirectory = cache;
+  else if (home && *home)
+    sDirectory = std::string(home) + "/.cache";
+  else
+    return "";
+
+  mkdir(sDirectory.data(), 0755);
+  return sDirectory + "/viewManager-textFaces.index";
+}
+
+/**
+\internal
+\brief reads the names resolved by an earlier run. The index is used only
+when each of the font directories it notes has the same modification
+time, a font added or removed changes the time of its directory. Names
+whose file no longer exists are resolved again.
+
+The file holds a version line, a line for each directory
+\code
+d <seconds> <nanoseconds> <directory>
+\endcode
+and a line for each name, separated from its file by a tab.
+\code
+f <name>\t<file>
+\endcode
+*/
+void viewManager::Visualizer::fontResolver::readIndex(void) {
+  m_bIndexRead = true;
+  std::ifstream index(indexFilename());
+  if (!index)
+    return;
+
+  std::string sLine;
+  if (!std::getline(index, sLine) || sLine != "viewManager-textFaces 1")
+    return;
+
+  std::map<std::string, std::pair<long, long>> directories;
+  std::unordered_map<std::string, std::string> files;
+  while (std::getline(index, sLine)) {
+    if (sLine.size() < 2)
+      return;
+
+    if (sLine[0] == 'd') {
+      std::istringstream ss(sLine.substr(2));
+      long seconds, nanoseconds;
+      std::string sDirectory;
+      if (!(ss >> seconds >> nanoseconds) || !std::getline(ss >> std::ws,
+                                                           sDirectory))
+        return;
+
+      if (modified(sDirectory) != std::make_pair(seconds, nanoseconds))
+        return;
+      directories[sDirectory] = {seconds, nanoseconds};
+
+    } else if (sLine[0] == 'f') {
+      std::size_t tab = sLine.find('\t', 2);
+      if (tab == std::string::npos)
+        return;
+
+      std::string sFile = sLine.substr(tab + 1);
+      struct stat info;
+      if (stat(sFile.data(), &info) == 0)
+        files[sLine.substr(2, tab - 2)] = sFile;
+
+    } else {
+      return;
+    }
+  }
+
+  if (directories.empty())
+    return;
+
+  m_directories = std::move(directories);
+  m_files = std::move(files);
+}
+
+/**
+\internal
+\brief writes the resolved names along with the directories of the
+configuration. The file is written beside the index and renamed over it,
+so another process does not read it partially written.
+*/
+void viewManager::Visualizer::fontResolver::writeIndex(void) {
+  if (m_directories.empty())
+    return;
+
+  std::string sFilename = indexFilename();
+  if (sFilename.empty())
+    return;
+
+  std::string sTemporary =
+      sFilename + "." + std::to_string(static_cast<long>(getpid()));
+  {
+    std::ofstream index(sTemporary, std::ios::trunc);
+    if (!index)
+      return;
+
+    index << "viewManager-textFaces 1\n";
+    for (auto &n : m_directories)
+      index << "d " << n.second.first << " " << n.second.second << " "
+            << n.first << "\n";
+    for (auto &n : m_files)
+      if (!n.second.empty() && n.first.find_first_of("\t\n") == n.first.npos)
+        index << "f " << n.first << "\t" << n.second << "\n";
+    if (!index.flush())
+      return;
+  }
+  std::rename(sTemporary.data(), sFilename.data());
+}
+#endif
+
+#if defined(__linux__)
+/**
+\internal
+\brief returns the mapping of the font file, mapping it the first time.
+The caller holds a reference until it calls release. A nullptr is returned
+when the file cannot be mapped.
+*/
+viewManager::Visualizer::mappedFontFiles::mappedFile *
+viewManager::Visualizer::mappedFontFiles::acquire(const std::string &sPath) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::unique_ptr<mappedFile> &file = m_files[sPath];
+  if (!file) {
+    int fd = open(sPath.data(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      m_files.erase(sPath);
+      return nullptr;
+    }
+
+    struct stat info;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+      data = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ,
+                  MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      m_files.erase(sPath);
+      return nullptr;
+    }
+
+    file = std::make_unique<mappedFile>(
+        mappedFile{sPath, static_cast<const FT_Byte *>(data),
+                   static_cast<std::size_t>(info.st_size), 0});
+  }
+
+  file->references++;
+  return file.get();
+}
+
+/**
+\internal
+\brief notes that a face opened from the file has closed. The mapping is
+kept for the faces opened later.
+*/
+void viewManager::Visualizer::mappedFontFiles::release(mappedFile *file) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (file && file->references)
+    file->references--;
+}
+
+/**
+\internal
+\brief unmaps the files that no face is open on. A file still in use by
+a face is left to the end of the process.
+*/
+viewManager::Visualizer::mappedFontFiles::~mappedFontFiles() {
+  for (auto &n : m_files)
+    if (n.second->references == 0)
+      munmap(const_cast<FT_Byte *>(n.second->data), n.second->size);
+}
+#endif
+
+/**
+\internal
+\brief The function provides the building and location of a textFace name
+The function independently works on linux vs. windows. The linux is much
+more advanced in that it uses the fontconfig api. This api provides for
+family matching as a browser would incorporate. Whereas the windows portion
+uses the registry access and simply compares a string.
+
+The function comes from the following source:
+https://stackoverflow.com/questions/10542832/how-to-use-fontconfig-to-get-font-list-c-c
+https://stackoverflow.com/questions/3954223/platform-independent-way-to-get-font-directory
+
+\param sTextFace
+
+*/
+std::string viewManager::Visualizer::platform::getFontFilename(
+    const std::string &sTextFace) {
+  std::string fontFileReturn;
+
+#if defined(__linux__)
+
+  // the fontconfig configuration and the names already resolved are
+  // shared by the process.
+  fontFileReturn = fontFiles.filename(sTextFace);
 
 #elif defined(_WIN64)
 
@@ -4149,96 +5989,107 @@ https://www.codeguru.com/cpp/cpp/algorithms/general/article.php/c15989/Tip-An-Op
 
 */
 void viewManager::Visualizer::platform::drawText(
-    const std::string &sTextFace, const int pointSize, const std::string &s,
+    const std::string &sTextFace, const int pointSize, std::string_view s,
     const unsigned int foregroundColor, int x1, int y1, int x2, int y2,
     textAlignment tAlign) {
-  bool bProcessedOnce = false;
+  drawTextLines(sTextFace, pointSize, foregroundColor,
+                {{s, x1, y1, x2, y2}});
+}
+
+/**
+\internal
+\brief draws the lines of text in one face, size and color. The face is
+resolved and its size activated once for all of the lines, and only when
+one of them is within the clipping rectangle. Each line is drawn from
+its shaped run, the glyphs are placed where the measure placed them.
+*/
+void viewManager::Visualizer::platform::drawTextLines(
+    const std::string &sTextFace, const int pointSize,
+    const unsigned int foregroundColor, const std::vector<textLine> &lines) {
   FT_Error error;
   FTC_ScalerRec scaler;
-  FT_Size sizeFace;
-  FT_UInt glyph_index = 0;
-  FT_UInt previous_index = 0;
-
-  // store a cache record for loaded fonts.
-  FTC_FaceID faceID = getFaceID(sTextFace);
-
-  // having this as a local variable
-  scaler.face_id = faceID;
-  scaler.pixel = 0;
-  scaler.height = (pointSize + fontScale) * 64;
-  scaler.width = (pointSize + fontScale) * 64;
-
-  scaler.x_res = 96;
-  scaler.y_res = 96;
-
-  // get the face
-  error = FTC_Manager_LookupSize(m_cacheManager, &scaler, &sizeFace);
+  FT_Size sizeFace = nullptr;
+  resolvedFont *font = nullptr;
+
+  for (auto &line : lines) {
+    // move to surface coordinates. Text entirely outside of the clipping
+    // rectangle is not drawn.
+    int x1 = line.x1 - m_originX;
+    int x2 = line.x2 - m_originX;
+    int y1 = line.y1 - m_originY;
+    int y2 = line.y2 - m_originY;
+    if (y1 >= m_clipY2 || y2 < m_clipY1 || x1 >= m_clipX2 || x2 < m_clipX1)
+      continue;
 
-  if (error)
-    throw std::runtime_error("Could not retrieve font face.");
+    if (!font) {
+      // store a cache record for loaded fonts.
+      FTC_FaceID faceID = getFaceID(sTextFace);
 
-  error = FT_Activate_Size(sizeFace);
-  if (error)
-    throw std::runtime_error("Could FT_Activate_Size for font.");
+      // having this as a local variable
+      scaler.face_id = faceID;
+      scaler.pixel = 0;
+      scaler.height = (pointSize + fontScale) * 64;
+      scaler.width = (pointSize + fontScale) * 64;
 
-  FT_Face face = sizeFace->face;
+      scaler.x_res = 96;
+      scaler.y_res = 96;
 
-  // get the height of the font
-  int faceHeight = face->size->metrics.height >> 6;
-  int lHeight = faceHeight;
-  int xpos = x1;
-  int ypos = y1;
+      // get the face
+      error = FTC_Manager_LookupSize(m_cacheManager, &scaler, &sizeFace);
 
-  // iterate characters in string
-  for (auto &c : s) {
+      if (error)
+        throw std::runtime_error("Could not retrieve font face.");
 
-    // exit when rectangle has been filled
-    if (ypos > y2)
-      break;
+      error = FT_Activate_Size(sizeFace);
+      if (error)
+        throw std::runtime_error("Could FT_Activate_Size for font.");
 
-    // handle special characters
-    // new line
-    if (c == '\n') {
-      xpos = x1;
-      ypos += lHeight;
-      continue;
-      // tab
-    } else if (c == '\t') {
-      xpos += 50;
-      continue;
+      // the glyphs and their positions are those of the measure.
+      font = &m_fonts.get(m_cacheManager, m_cmapCache, faceID,
+                          pointSize + fontScale);
     }
 
-    FT_UInt glyph_index = 0;
+    const resolvedFont::shapedRun &run = font->shape(line.text);
+    int lHeight = font->faceHeight;
+    int xpos = x1;
+    int ypos = y1;
 
-    // get the index of the glyph
-    glyph_index = FTC_CMapCache_Lookup(m_cmapCache, faceID, 0, c);
+    // iterate the glyphs of the shaped text
+    for (auto &g : run.glyphs) {
 
-    // the kerning of a font depends on the previous character
-    // some proportional fonts provide tighter spacing which improves
-    // rendering characteristics
-    if (FT_HAS_KERNING(face) && bProcessedOnce) {
-      FT_Vector akerning;
-      error = FT_Get_Kerning(face, previous_index, glyph_index,
-                             FT_KERNING_DEFAULT, &akerning);
-      if (!error) {
-        xpos += akerning.x >> 6;
-      }
-    }
+      // exit when rectangle has been filled
+      if (ypos > y2)
+        break;
 
-    // render the character
-    int xadvance = drawChar(xpos, ypos, x2, y2, c, foregroundColor, glyph_index,
-                            sizeFace, &scaler);
+      // handle special characters
+      // new line
+      if (g.control == '\n') {
+        xpos = x1;
+        ypos += lHeight;
+        continue;
+        // tab
+      } else if (g.control == '\t') {
+        xpos += g.advance;
+        continue;
+      }
 
-    // move after render
-    xpos += xadvance;
-    // wrap text
-    if (xpos > x2) {
-      xpos = x1;
-      ypos += lHeight;
+      // the kerning of a font depends on the previous character
+      // some proportional fonts provide tighter spacing which improves
+      // rendering characteristics
+      xpos += g.kerning;
+
+      // render the character
+      drawChar(xpos + g.xOffset, ypos - g.yOffset, x2, y2, foregroundColor,
+               g.glyph, sizeFace, &scaler);
+
+      // move after render, by the advance the text was measured with.
+      xpos += g.advance;
+      // wrap text
+      if (xpos > x2) {
+        xpos = x1;
+        ypos += lHeight;
+      }
     }
-
-    bProcessedOnce = true;
-    previous_index = glyph_index;
   }
 }
 
@@ -4256,7 +6107,6 @@ explanitory.
 \param const int yPos is the top coordinate to start rendering
 \param const int xPos2 is the clipping right position
 \param const int yPos2 is the clipping bottom position
-\param const char c is the individual character
 \param const unsigned int foregroundColor is the forgeound color of the
 text.
 \param FT_UInt glyph_index is the index of the character.
@@ -4265,162 +6115,870 @@ text.
 */
 int viewManager::Visualizer::platform::drawChar(
     const int xPos, const int yPos, const int xPos2, const int yPos2,
-    const char c, const unsigned int foregroundColor, FT_UInt glyph_index,
+    const unsigned int foregroundColor, FT_UInt glyph_index,
     const FT_Size sizeFace, const FTC_Scaler pscaler) {
   FT_Error error;
-  unsigned int color = 0x00; // computed color
   int x, y;
 
-  // get color components of the foreground color used later.
-  unsigned char foregroundR = foregroundColor >> 16;
-  unsigned char foregroundG = foregroundColor >> 8;
-  unsigned char foregroundB = foregroundColor;
-
   FT_Face face = sizeFace->face;
 
   // get the height of the font
-  int faceHeight = face->size->metrics.height >> 6;
-  int baseline=face->size->metrics.ascender>>6;
-
-  /**
-  \brief use greyscale or color lcd filtering
-\details
-      There are two distinct types of bimap structures that are in use, grey
-      scale or lcd filtered. The buffer format is unique for each, the grey
-  lite one being a value indicating grey luminence while the lcd filter is a
-  rgb one. These values provide the same functionality for the looping and
-      drawing routine. You will notice that within each block of code, after
-      getting the image, these values are set.
-  */
-  int storageSize, pitch, top, left, height, width, xadvance;
-  unsigned char *buffer;
+  int baseline = face->size->metrics.ascender >> 6;
+
+  // the glyph is drawn from the atlas of the face at the size. It is
+  // encoded from the bitmap the first time it is drawn.
+  glyphAtlas &atlas = glyphAtlases.get(pscaler);
+  glyphAtlas::glyph *g = atlas.find(glyph_index);
+  if (g) {
+    glyphAtlases.hits++;
+  } else {
+    glyphAtlases.misses++;
+    /**
+    \brief use greyscale or color lcd filtering
+  \details
+        There are two distinct types of bimap structures that are in use,
+    grey scale or lcd filtered. The buffer format is unique for each, the
+    grey lite one being a value indicating grey luminence while the lcd
+    filter is a rgb one. These values provide the same functionality for
+    the encoding of the runs. You will notice that within each block of
+    code, after getting the image, these values are set.
+    */
+    int storageSize, pitch, top, left, height, width, xadvance;
+    unsigned char *buffer;
 
 #ifdef USE_GREYSCALE_ANTIALIAS
-  // get the image
-  FTC_SBit bitmap;
-  error = FTC_SBitCache_LookupScaler(m_bitCache, pscaler, FT_LOAD_RENDER,
-                                     glyph_index, &bitmap, nullptr);
-
-  if (error)
-    return 0;
+    // get the image
+    FTC_SBit bitmap;
+    error = FTC_SBitCache_LookupScaler(m_bitCache, pscaler, FT_LOAD_RENDER,
+                                       glyph_index, &bitmap, nullptr);
 
-  // set the rendering values used for for grey
-  storageSize = 1;
-  pitch = bitmap->pitch;
-  top = bitmap->top;
-  left = bitmap->left;
-  height = bitmap->height;
-  width = bitmap->width;
-  buffer = bitmap->buffer;
-  xadvance = bitmap->xadvance;
+    if (error)
+      return 0;
+
+    // set the rendering values used for for grey
+    storageSize = 1;
+    pitch = bitmap->pitch;
+    top = bitmap->top;
+    left = bitmap->left;
+    height = bitmap->height;
+    width = bitmap->width;
+    buffer = bitmap->buffer;
+    xadvance = bitmap->xadvance;
 
 #elif defined USE_LCD_FILTER
-  FT_Glyph aglyph;
-  FT_BitmapGlyph bitmap;
-
-  // get the image, however this is just the outline
-  error = FTC_ImageCache_LookupScaler(m_imageCache, pscaler, FT_LOAD_DEFAULT,
-                                      glyph_index, &aglyph, nullptr);
-  if (error)
-    return 0;
+    FT_Glyph aglyph;
+    FT_BitmapGlyph bitmap;
 
-  xadvance = (aglyph->advance.x + 0x8000) >> 16;
+    // get the image, however this is just the outline
+    error = FTC_ImageCache_LookupScaler(m_imageCache, pscaler,
+                                        FT_LOAD_DEFAULT, glyph_index, &aglyph,
+                                        nullptr);
+    if (error)
+      return 0;
 
-  // this converts the outline image to a rgb bitmap
-  error = FT_Glyph_To_Bitmap(&aglyph, FT_RENDER_MODE_LCD, 0, 0);
-  bitmap = reinterpret_cast<FT_BitmapGlyph>(aglyph);
+    xadvance = (aglyph->advance.x + 0x8000) >> 16;
 
-  // set the rendering values used for for grey
-  storageSize = 3;
-  pitch = bitmap->bitmap.pitch;
-  top = bitmap->top;
-  left = bitmap->left;
-  height = bitmap->bitmap.rows;
-  width = bitmap->bitmap.width;
-  buffer = bitmap->bitmap.buffer;
+    // this converts the outline image to a rgb bitmap, the outline is
+    // owned by the image cache and is not destroyed. The bitmap is only
+    // needed until the glyph is encoded within the atlas.
+    error = FT_Glyph_To_Bitmap(&aglyph, FT_RENDER_MODE_LCD, 0, 0);
+    if (error)
+      return xadvance;
+    bitmap = reinterpret_cast<FT_BitmapGlyph>(aglyph);
+
+    // set the rendering values used for for grey
+    storageSize = 3;
+    pitch = bitmap->bitmap.pitch;
+    top = bitmap->top;
+    left = bitmap->left;
+    height = bitmap->bitmap.rows;
+    width = bitmap->bitmap.width;
+    buffer = bitmap->bitmap.buffer;
 
 #endif
 
-  x = xPos;
-  y = yPos +  baseline - top;
+    g = atlas.insert(glyph_index, buffer, pitch, width / storageSize, height,
+                     storageSize, left, top, xadvance);
 
-  // calculate the maximum bounds
-  int xmax = x + width / storageSize + left;
-  int ymax = yPos + (baseline-top) + height;
-
-  // if the maximum bounds are greater than the clipping region, adjust.
-  if (xmax > xPos2)
-    xmax = xPos2;
-  if (ymax > yPos2)
-    ymax = yPos2;
+#ifdef USE_LCD_FILTER
+    // delete the bitmap data
+    FT_Done_Glyph((FT_Glyph)bitmap);
+#endif
+  }
 
-  // loop through the pixels
-  for (int i = x + left, p = 0; i < xmax; i++, p += storageSize) {
-    for (int j = y, q = 0; j < ymax; j++, q++) {
-      int bufferPosition = q * pitch + p;
+  x = xPos + g->left;
+  y = yPos + baseline - g->top;
+
+  // the rectangle of the glyph is clipped once, the maximum bounds by the
+  // clipping position given as well.
+  int x1 = std::max(x, m_clipX1);
+  int y1 = std::max(y, m_clipY1);
+  int x2 = std::min({x + g->width, xPos2, m_clipX2});
+  int y2 = std::min({y + g->height, yPos2, m_clipY2});
+  if (x1 >= x2 || y1 >= y2)
+    return g->xadvance;
+
+  paintCommand c = {paintCommand::glyphRun, &atlas, *g, x, y, x1,
+                    y1,  x2, y2, foregroundColor, 0};
+  if (m_bRecording)
+    m_commands.push_back(c);
+  else
+    paint(c, x1, y1, x2, y2);
 
-      /* only plot active pixels, the term
-       luminance is used because it is not actually a color
-       but a brightness of the pixel. Zero being off for the
-       glyph bitmap. */
-      if (buffer[bufferPosition]) {
+  return g->xadvance;
+}
 
-        unsigned int destinationC = getPixel(i, j);
+/**
+\internal
+\brief plays the command within the rectangle, which is within the
+rectangle of the command. The glyph is blended from the runs of its
+atlas, a band is painted a row at a time and the clearing fills with
+white.
+*/
+void viewManager::Visualizer::platform::paint(const paintCommand &c,
+                                              const int x1, const int y1,
+                                              const int x2, const int y2) {
+  unsigned int *pixels = reinterpret_cast<unsigned int *>(m_pixels);
+  if (c.kind == paintCommand::clearing) {
+    for (int y = y1; y < y2; y++)
+      std::fill(pixels + y * _w + x1, pixels + y * _w + x2, 0xFFFFFFFF);
+    return;
+  }
+  if (c.kind == paintCommand::bandRun) {
+    for (int y = y1; y < y2; y++)
+      paintBand(m_bands[c.band], y, x1, x2);
+    return;
+  }
 
-        unsigned char destinationR = destinationC >> 16;
-        unsigned char destinationG = destinationC >> 8;
-        unsigned char destinationB = destinationC;
+  // the color of a fully covered pixel, as blendSpan computes it.
+  unsigned int opaqueColor = 0;
+  for (int shift = 0; shift < 24; shift += 8)
+    opaqueColor |= ((((c.color >> shift) & 0xFF) * 255) >> 8) << shift;
+
+  const std::uint32_t *run = c.atlas->runs(c.g);
+  for (std::uint32_t i = 0; i < c.g.runs; i++) {
+    int row = c.y + static_cast<int>(run[0] >> 16);
+    int column = c.x + static_cast<int>(run[0] & 0xFFFF);
+    int length = static_cast<int>(run[1] >> 1);
+    bool bOpaque = run[1] & glyphAtlas::opaque;
+    const std::uint32_t *coverage = run + 2;
+    run += bOpaque ? 2 : 2 + length;
+
+    // the runs are in row order.
+    if (row >= y2)
+      break;
+    if (row < y1)
+      continue;
 
-#ifdef USE_GREYSCALE_ANTIALIAS
-        // luminance is expressed in greyscal using one byte
-        unsigned char freetypeColor = buffer[bufferPosition];
-        unsigned char freetypeR = freetypeColor;
-        unsigned char freetypeG = freetypeColor;
-        unsigned char freetypeB = freetypeColor;
+    int begin = std::max(column, x1);
+    int end = std::min(column + length, x2);
+    if (begin >= end)
+      continue;
 
-#elif defined USE_LCD_FILTER
-        // luminance is expressed within the LCD format as three bytes.
-        unsigned char freetypeR = buffer[bufferPosition];
-        unsigned char freetypeG = buffer[bufferPosition + 1];
-        unsigned char freetypeB = buffer[bufferPosition + 2];
-#endif
+    unsigned int *p = pixels + row * _w + begin;
+    if (bOpaque)
+      std::fill(p, p + (end - begin), opaqueColor);
+    else
+      blendSpan(p, coverage + (begin - column), end - begin, c.color);
+  }
+}
 
-        unsigned char targetR =
-            ((foregroundR * freetypeR) + (destinationR * (255 - freetypeR))) >>
-            8;
-        unsigned char targetG =
-            ((foregroundG * freetypeG) + (destinationG * (255 - freetypeG))) >>
-            8;
-        unsigned char targetB =
-            ((foregroundB * freetypeB) + (destinationB * (255 - freetypeB))) >>
-            8;
+/**
+\internal
+\brief begins the recording of the painting. The glyphs are looked up and
+encoded as they are drawn, while the pixels are left until endPaint.
+*/
+void viewManager::Visualizer::platform::beginPaint(void) {
+  m_commands.clear();
+  m_bands.clear();
+  m_bRecording = true;
+}
 
-        color = ((targetR) << 16) | ((targetG) << 8) | (targetB);
+/**
+\internal
+\brief paints the recorded commands. The surface is divided in tiles of
+tileSize pixels and each command is listed by the tiles its rectangle
+touches. The tiles are painted by the workers, each plays its commands in
+the order recorded, clipped to the tile. Every pixel is within one tile,
+so it is painted as when the commands are played in order by one thread.
+*/
+void viewManager::Visualizer::platform::endPaint(threadPool &workers) {
+  m_bRecording = false;
+  if (m_commands.empty())
+    return;
 
-        // place the computed color into pixel buffer
-        putPixel(i, j, color);
-      }
-    }
+  int columns = (_w + tileSize - 1) / tileSize;
+  int rows = (_h + tileSize - 1) / tileSize;
+  m_tiles.resize(static_cast<std::size_t>(columns * rows));
+  for (auto &t : m_tiles)
+    t.clear();
+
+  for (std::size_t i = 0; i < m_commands.size(); i++) {
+    const paintCommand &c = m_commands[i];
+    for (int row = c.y1 / tileSize; row <= (c.y2 - 1) / tileSize; row++)
+      for (int column = c.x1 / tileSize; column <= (c.x2 - 1) / tileSize;
+           column++)
+        m_tiles[row * columns + column].push_back(
+            static_cast<std::uint32_t>(i));
   }
 
-#ifdef USE_LCD_FILTER
-  // delete the bitmap data
-  FT_Done_Glyph((FT_Glyph)bitmap);
-
-#endif
-
-  return xadvance;
+  workers.parallelFor(
+      m_tiles.size(), [this, columns](std::size_t idx, std::size_t) {
+        int tileX1 = static_cast<int>(idx % columns) * tileSize;
+        int tileY1 = static_cast<int>(idx / columns) * tileSize;
+        int tileX2 = std::min(tileX1 + tileSize, static_cast<int>(_w));
+        int tileY2 = std::min(tileY1 + tileSize, static_cast<int>(_h));
+        for (auto i : m_tiles[idx]) {
+          const paintCommand &c = m_commands[i];
+          paint(c, std::max(c.x1, tileX1), std::max(c.y1, tileY1),
+                std::min(c.x2, tileX2), std::min(c.y2, tileY2));
+        }
+      });
+  m_commands.clear();
+  m_bands.clear();
 }
 
 /**
-\brief The routine returns that face ID for the cached font. This is a
-pointer to the record within the vector.
+\internal
+\brief draws the box of an element. The background is painted within the
+border, then the border over the edge. The radius and the border width
+are limited to half of the smaller side of the box. A doubled border of
+at least three pixels is two lines of a third of its width. Dotted
+borders are square dots of the border width, dashed borders dashes of
+three times the width, both separated by gaps of twice the width along
+each side. The inset, outset, groove and ridge borders are painted in
+two tones, the color and its channels halved, a black border being
+lightened to grey instead. An inset border is darker at the top and
+left, an outset border at the bottom and right. A groove border is
+inset in its outer half and outset in its inner half, a ridge border
+the reverse.
 */
-FTC_FaceID viewManager::Visualizer::platform::getFaceID(string sTextFace) {
-  FTC_FaceID faceID = nullptr;
+void viewManager::Visualizer::platform::drawBox(const boxStyle &box) {
+  // move to surface coordinates.
+  int x1 = std::min(box.x1, box.x2) - m_originX;
+  int y1 = std::min(box.y1, box.y2) - m_originY;
+  int x2 = std::max(box.x1, box.x2) - m_originX;
+  int y2 = std::max(box.y1, box.y2) - m_originY;
+  unsigned int alpha = std::min(box.alpha, 255u);
+  if (x1 >= x2 || y1 >= y2 || !alpha)
+    return;
 
-  auto it = m_faceCache.find(sTextFace);
-  if (it != m_faceCache.end()) {
+  int half = std::min(x2 - x1, y2 - y1) / 2;
+  int radius = std::clamp(box.radius, 0, half);
+  int borderWidth = box.border == borderStyle::none
+                        ? 0
+                        : std::clamp(box.borderWidth, 0, half);
+
+  if (box.bBackground)
+    drawBand(x1, y1, x2, y2, borderWidth, -1, radius, box.background,
+             box.background, 0, 0, alpha);
+  if (!borderWidth)
+    return;
+
+  unsigned int color = box.borderColor & 0x00FFFFFF;
+  unsigned int light = color ? color : 0x00808080;
+  unsigned int dark = (light >> 1) & 0x007F7F7F;
+  int halfWidth = borderWidth / 2;
+
+  switch (box.border) {
+  case borderStyle::doubled:
+    if (borderWidth >= 3) {
+      int line = (borderWidth + 1) / 3;
+      drawBand(x1, y1, x2, y2, 0, line, radius, color, color, 0, 0, alpha);
+      drawBand(x1, y1, x2, y2, borderWidth - line, borderWidth, radius, color,
+               color, 0, 0, alpha);
+    } else {
+      drawBand(x1, y1, x2, y2, 0, borderWidth, radius, color, color, 0, 0,
+               alpha);
+    }
+    break;
+  case borderStyle::dotted:
+    drawBand(x1, y1, x2, y2, 0, borderWidth, radius, color, color,
+             borderWidth, 2 * borderWidth, alpha);
+    break;
+  case borderStyle::dashed:
+    drawBand(x1, y1, x2, y2, 0, borderWidth, radius, color, color,
+             3 * borderWidth, 2 * borderWidth, alpha);
+    break;
+  case borderStyle::inset:
+    drawBand(x1, y1, x2, y2, 0, borderWidth, radius, dark, light, 0, 0, alpha);
+    break;
+  case borderStyle::outset:
+    drawBand(x1, y1, x2, y2, 0, borderWidth, radius, light, dark, 0, 0, alpha);
+    break;
+  case borderStyle::groove:
+    if (halfWidth)
+      drawBand(x1, y1, x2, y2, 0, halfWidth, radius, dark, light, 0, 0, alpha);
+    drawBand(x1, y1, x2, y2, halfWidth, borderWidth, radius, light, dark, 0, 0,
+             alpha);
+    break;
+  case borderStyle::ridge:
+    if (halfWidth)
+      drawBand(x1, y1, x2, y2, 0, halfWidth, radius, light, dark, 0, 0, alpha);
+    drawBand(x1, y1, x2, y2, halfWidth, borderWidth, radius, dark, light, 0, 0,
+             alpha);
+    break;
+  default:
+    drawBand(x1, y1, x2, y2, 0, borderWidth, radius, color, color, 0, 0,
+             alpha);
+    break;
+  }
+}
+
+/**
+\internal
+\brief draws a band of the box given in surface coordinates. The part of
+the band within the clipping rectangle is recorded, or painted when the
+painting is not recorded.
+*/
+void viewManager::Visualizer::platform::drawBand(
+    const int x1, const int y1, const int x2, const int y2, const int outer,
+    const int inner, const int radius, const unsigned int color,
+    const unsigned int shade, const int dash, const int gap,
+    const unsigned int alpha) {
+  boxBand b = {x1,
+               y1,
+               x2 - x1,
+               y2 - y1,
+               outer,
+               std::max(radius - outer, 0),
+               nullptr,
+               inner,
+               std::max(radius - inner, 0),
+               nullptr,
+               color,
+               shade,
+               dash,
+               gap,
+               alpha};
+
+  int cx1 = std::max(x1 + outer, m_clipX1);
+  int cy1 = std::max(y1 + outer, m_clipY1);
+  int cx2 = std::min(x2 - outer, m_clipX2);
+  int cy2 = std::min(y2 - outer, m_clipY2);
+  if (cx1 >= cx2 || cy1 >= cy2)
+    return;
+
+  b.outerCorner = cornerCoverage(b.outerRadius);
+  if (inner >= 0)
+    b.innerCorner = cornerCoverage(b.innerRadius);
+
+  m_bands.push_back(b);
+  paintCommand c = {paintCommand::bandRun, nullptr, {}, 0, 0, cx1, cy1, cx2,
+                    cy2, color, static_cast<std::uint32_t>(m_bands.size() - 1)};
+  if (m_bRecording) {
+    m_commands.push_back(c);
+  } else {
+    paint(c, cx1, cy1, cx2, cy2);
+    m_bands.pop_back();
+  }
+}
+
+/**
+\internal
+\brief returns the coverage of the pixels of a top left corner of the
+radius, a row after another. The circle is centered at (radius, radius).
+Each row of pixels is sampled along sixteen lines, upon which a pixel is
+covered by the part of it right of the circle's edge. The table is
+computed the first time the radius is drawn and kept, a radius of zero
+has none.
+*/
+const std::uint8_t *
+viewManager::Visualizer::platform::cornerCoverage(const int radius) {
+  if (radius <= 0)
+    return nullptr;
+
+  auto it = m_corners.find(radius);
+  if (it != m_corners.end())
+    return it->second.data();
+
+  const int samples = 16;
+  std::vector<std::uint8_t> &table = m_corners[radius];
+  table.resize(static_cast<std::size_t>(radius * radius));
+  std::vector<double> covered(radius);
+  double r = radius;
+  for (int j = 0; j < radius; j++) {
+    std::fill(covered.begin(), covered.end(), 0.0);
+    for (int s = 0; s < samples; s++) {
+      double dy = r - (j + (s + 0.5) / samples);
+      double edge = r - std::sqrt(std::max(r * r - dy * dy, 0.0));
+      for (int i = 0; i < radius; i++)
+        covered[i] += std::clamp(i + 1 - edge, 0.0, 1.0);
+    }
+    for (int i = 0; i < radius; i++)
+      table[j * radius + i] =
+          static_cast<std::uint8_t>(std::lround(covered[i] * 255 / samples));
+  }
+  return table.data();
+}
+
+/**
+\internal
+\brief paints the row of the band between the columns, given in surface
+coordinates. The row is divided where the corners of the two insets begin
+and end, and where the shade begins. The parts covered entirely are
+filled by fillSpan and those within the hole are skipped, the pixels of
+the corners are blended by their coverage. The pixels of a dashed band
+are blended, those within its gaps with no coverage.
+*/
+void viewManager::Visualizer::platform::paintBand(const boxBand &b,
+                                                  const int y, const int x1,
+                                                  const int x2) {
+  int ry = y - b.y;
+
+  // the coverage of the rounded rectangle of the inset, the distance to
+  // the nearest sides selects the pixel of the corner.
+  auto coverage = [&b, ry](const std::uint8_t *corner, const int radius,
+                           const int inset, const int rx) -> unsigned int {
+    int cx = rx - inset;
+    int cy = ry - inset;
+    int w = b.w - 2 * inset;
+    int h = b.h - 2 * inset;
+    if (cx < 0 || cy < 0 || cx >= w || cy >= h)
+      return 0;
+    int i = std::min(cx, w - 1 - cx);
+    int j = std::min(cy, h - 1 - cy);
+    return i < radius && j < radius ? corner[j * radius + i] : 255;
+  };
+
+  // the width of the corners of an inset upon the row, zero when the row
+  // is between them, or -1 when the row is outside of the inset.
+  auto cornerWidth = [&b, ry](const int radius, const int inset) {
+    int cy = ry - inset;
+    int h = b.h - 2 * inset;
+    if (inset < 0 || cy < 0 || cy >= h || b.w - 2 * inset <= 0)
+      return -1;
+    return std::min(cy, h - 1 - cy) < radius ? radius : 0;
+  };
+
+  // whether the pixel is within a dash. The corners where two sides of the
+  // band meet are. Otherwise the distance along the side of the box nearest
+  // to the pixel is taken from the corner the side begins at, going
+  // clockwise, so that each side begins with a dash.
+  auto dashed = [&b, ry](const int rx) {
+    int top = ry;
+    int right = b.w - 1 - rx;
+    int bottom = b.h - 1 - ry;
+    int left = rx;
+    if (std::min(top, bottom) < b.inner && std::min(left, right) < b.inner)
+      return true;
+    int nearest = std::min({top, right, bottom, left});
+    int along = nearest == top      ? rx
+                : nearest == right  ? ry
+                : nearest == bottom ? b.w - 1 - rx
+                                    : b.h - 1 - ry;
+    return along % (b.dash + b.gap) < b.dash;
+  };
+
+  int outerWidth = cornerWidth(b.outerRadius, b.outer);
+  int innerWidth = cornerWidth(b.innerRadius, b.inner);
+  if (outerWidth < 0)
+    return;
+
+  // the pixels nearer the top or left edge of the box than the bottom or
+  // right come first upon the row, the shade begins after them.
+  int shadeBegin = b.w;
+  if (b.shade != b.color) {
+    auto topLeft = [&b, ry](const int rx) {
+      return std::min(ry, rx) <= std::min(b.h - 1 - ry, b.w - 1 - rx);
+    };
+    int low = 0;
+    int high = b.w;
+    while (low < high) {
+      int middle = (low + high) / 2;
+      if (topLeft(middle))
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    shadeBegin = low;
+  }
+
+  std::array<int, 11> cuts;
+  std::size_t count = 0;
+  cuts[count++] = x1 - b.x;
+  cuts[count++] = x2 - b.x;
+  for (int c : {b.outer + outerWidth, b.w - b.outer - outerWidth})
+    cuts[count++] = c;
+  if (innerWidth >= 0)
+    for (int c : {b.inner, b.inner + innerWidth, b.w - b.inner - innerWidth,
+                  b.w - b.inner})
+      cuts[count++] = c;
+  cuts[count++] = shadeBegin;
+  std::sort(cuts.begin(), cuts.begin() + count);
+
+  unsigned int *row = reinterpret_cast<unsigned int *>(m_pixels) + y * _w + b.x;
+  std::array<unsigned int, 64> spans;
+  for (std::size_t k = 0; k + 1 < count; k++) {
+    int begin = std::max(cuts[k], x1 - b.x);
+    int end = std::min(cuts[k + 1], x2 - b.x);
+    if (begin >= end)
+      continue;
+
+    // the part is on one side of each cut, its first pixel tells which.
+    bool bOuterFull = begin >= b.outer + outerWidth &&
+                      begin < b.w - b.outer - outerWidth;
+    bool bInner = innerWidth >= 0 && begin >= b.inner &&
+                  begin < b.w - b.inner;
+    bool bHole = bInner && begin >= b.inner + innerWidth &&
+                 begin < b.w - b.inner - innerWidth;
+    if (bHole)
+      continue;
+    unsigned int color = begin < shadeBegin ? b.color : b.shade;
+    if (bOuterFull && !bInner && !b.dash) {
+      fillSpan(row + begin, end - begin, color, b.alpha);
+      continue;
+    }
+
+    for (int x = begin; x < end; x += static_cast<int>(spans.size())) {
+      int n = std::min(end - x, static_cast<int>(spans.size()));
+      for (int i = 0; i < n; i++) {
+        int c = static_cast<int>(
+            coverage(b.outerCorner, b.outerRadius, b.outer, x + i));
+        if (bInner)
+          c -= static_cast<int>(
+              coverage(b.innerCorner, b.innerRadius, b.inner, x + i));
+        if (b.dash && !dashed(x + i))
+          c = 0;
+        c = (std::max(c, 0) * static_cast<int>(b.alpha) + 127) / 255;
+        spans[i] = static_cast<unsigned int>(c) * 0x010101;
+      }
+      blendSpan(row + x, spans.data(), n, color);
+
+      // the blending darkens a covered pixel slightly, it is set instead.
+      for (int i = 0; i < n; i++)
+        if (spans[i] == 0xFFFFFF)
+          row[x + i] = color & 0x00FFFFFF;
+    }
+  }
+}
+
+/**
+\internal
+\brief the blending routine used by drawChar, chosen for the processor.
+*/
+viewManager::Visualizer::platform::blendSpanFunction
+    viewManager::Visualizer::platform::blendSpan =
+        viewManager::Visualizer::platform::selectBlendSpan();
+
+/**
+\internal
+\brief returns the widest blending routine the processor supports. Each
+produces the same pixels as blendSpanScalar.
+*/
+viewManager::Visualizer::platform::blendSpanFunction
+viewManager::Visualizer::platform::selectBlendSpan(void) {
+#if defined(USE_X86_BLEND)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return blendSpanAVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return blendSpanSSE2;
+#endif
+  return blendSpanScalar;
+}
+
+/**
+\internal
+\brief blends the span a pixel at a time. Each channel is
+(foreground * coverage + destination * (255 - coverage)) >> 8, and the
+byte above the red is cleared.
+*/
+void viewManager::Visualizer::platform::blendSpanScalar(
+    unsigned int *pixels, const unsigned int *coverage, const int n,
+    const unsigned int foreground) {
+  unsigned char foregroundR = foreground >> 16;
+  unsigned char foregroundG = foreground >> 8;
+  unsigned char foregroundB = foreground;
+
+  for (int i = 0; i < n; i++) {
+    unsigned char freetypeR = coverage[i] >> 16;
+    if (!freetypeR)
+      continue;
+
+    unsigned char freetypeG = coverage[i] >> 8;
+    unsigned char freetypeB = coverage[i];
+
+    unsigned int destinationC = pixels[i];
+    unsigned char destinationR = destinationC >> 16;
+    unsigned char destinationG = destinationC >> 8;
+    unsigned char destinationB = destinationC;
+
+    unsigned char targetR =
+        ((foregroundR * freetypeR) + (destinationR * (255 - freetypeR))) >> 8;
+    unsigned char targetG =
+        ((foregroundG * freetypeG) + (destinationG * (255 - freetypeG))) >> 8;
+    unsigned char targetB =
+        ((foregroundB * freetypeB) + (destinationB * (255 - freetypeB))) >> 8;
+
+    pixels[i] = ((targetR) << 16) | ((targetG) << 8) | (targetB);
+  }
+}
+
+#if defined(USE_X86_BLEND)
+/**
+\internal
+\brief blends the span four pixels at a time. The channels are widened to
+16 bits, where the sum of the two products, at most 255 * 255, does not
+overflow.
+*/
+__attribute__((target("sse2"))) void
+viewManager::Visualizer::platform::blendSpanSSE2(unsigned int *pixels,
+                                                 const unsigned int *coverage,
+                                                 const int n,
+                                                 const unsigned int foreground) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i full = _mm_set1_epi16(255);
+  const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+  const __m128i redMask = _mm_set1_epi32(0x00FF0000);
+  const __m128i color = _mm_unpacklo_epi8(
+      _mm_set1_epi32(static_cast<int>(foreground & 0x00FFFFFF)), zero);
+
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i *>(pixels + i));
+    __m128i a =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(coverage + i));
+
+    __m128i aLow = _mm_unpacklo_epi8(a, zero);
+    __m128i aHigh = _mm_unpackhi_epi8(a, zero);
+    __m128i low = _mm_srli_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(color, aLow),
+                      _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero),
+                                      _mm_sub_epi16(full, aLow))),
+        8);
+    __m128i high = _mm_srli_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(color, aHigh),
+                      _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero),
+                                      _mm_sub_epi16(full, aHigh))),
+        8);
+    __m128i blended = _mm_and_si128(_mm_packus_epi16(low, high), colorMask);
+
+    // pixels without red coverage keep the destination.
+    __m128i keep = _mm_cmpeq_epi32(_mm_and_si128(a, redMask), zero);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i),
+                     _mm_or_si128(_mm_and_si128(keep, d),
+                                  _mm_andnot_si128(keep, blended)));
+  }
+
+  blendSpanScalar(pixels + i, coverage + i, n - i, foreground);
+}
+
+/**
+\internal
+\brief blends the span eight pixels at a time, as blendSpanSSE2.
+*/
+__attribute__((target("avx2"))) void
+viewManager::Visualizer::platform::blendSpanAVX2(unsigned int *pixels,
+                                                 const unsigned int *coverage,
+                                                 const int n,
+                                                 const unsigned int foreground) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i full = _mm256_set1_epi16(255);
+  const __m256i colorMask = _mm256_set1_epi32(0x00FFFFFF);
+  const __m256i redMask = _mm256_set1_epi32(0x00FF0000);
+  const __m256i color = _mm256_unpacklo_epi8(
+      _mm256_set1_epi32(static_cast<int>(foreground & 0x00FFFFFF)), zero);
+
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i d = _mm256_loadu_si256(reinterpret_cast<__m256i *>(pixels + i));
+    __m256i a =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(coverage + i));
+
+    __m256i aLow = _mm256_unpacklo_epi8(a, zero);
+    __m256i aHigh = _mm256_unpackhi_epi8(a, zero);
+    __m256i low = _mm256_srli_epi16(
+        _mm256_add_epi16(_mm256_mullo_epi16(color, aLow),
+                         _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero),
+                                            _mm256_sub_epi16(full, aLow))),
+        8);
+    __m256i high = _mm256_srli_epi16(
+        _mm256_add_epi16(_mm256_mullo_epi16(color, aHigh),
+                         _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero),
+                                            _mm256_sub_epi16(full, aHigh))),
+        8);
+    __m256i blended =
+        _mm256_and_si256(_mm256_packus_epi16(low, high), colorMask);
+
+    // pixels without red coverage keep the destination.
+    __m256i keep = _mm256_cmpeq_epi32(_mm256_and_si256(a, redMask), zero);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(pixels + i),
+                        _mm256_blendv_epi8(blended, d, keep));
+  }
+
+  // the upper halves are cleared before the SSE2 instructions, which
+  // otherwise stall on the AVX state.
+  _mm256_zeroupper();
+  blendSpanSSE2(pixels + i, coverage + i, n - i, foreground);
+}
+#endif
+
+/**
+\internal
+\brief the filling routine used by the bands of boxes, chosen for the
+processor.
+*/
+viewManager::Visualizer::platform::fillSpanFunction
+    viewManager::Visualizer::platform::fillSpan =
+        viewManager::Visualizer::platform::selectFillSpan();
+
+/**
+\internal
+\brief returns the widest filling routine the processor supports. Each
+produces the same pixels as fillSpanScalar.
+*/
+viewManager::Visualizer::platform::fillSpanFunction
+viewManager::Visualizer::platform::selectFillSpan(void) {
+#if defined(USE_X86_BLEND)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return fillSpanAVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return fillSpanSSE2;
+#endif
+  return fillSpanScalar;
+}
+
+/**
+\internal
+\brief fills the span a pixel at a time. With an alpha of 255 the pixels
+are set to the color, otherwise each channel is
+(color * alpha + destination * (255 - alpha)) >> 8. The byte above the
+red is cleared, and an alpha of zero leaves the pixels.
+*/
+void viewManager::Visualizer::platform::fillSpanScalar(
+    unsigned int *pixels, const int n, const unsigned int color,
+    const unsigned int alpha) {
+  if (!alpha || n <= 0)
+    return;
+  if (alpha >= 255) {
+    std::fill(pixels, pixels + n, color & 0x00FFFFFF);
+    return;
+  }
+
+  unsigned int sourceR = ((color >> 16) & 0xFF) * alpha;
+  unsigned int sourceG = ((color >> 8) & 0xFF) * alpha;
+  unsigned int sourceB = (color & 0xFF) * alpha;
+  unsigned int inverse = 255 - alpha;
+
+  for (int i = 0; i < n; i++) {
+    unsigned int destinationC = pixels[i];
+    unsigned int targetR =
+        (sourceR + ((destinationC >> 16) & 0xFF) * inverse) >> 8;
+    unsigned int targetG =
+        (sourceG + ((destinationC >> 8) & 0xFF) * inverse) >> 8;
+    unsigned int targetB = (sourceB + (destinationC & 0xFF) * inverse) >> 8;
+    pixels[i] = (targetR << 16) | (targetG << 8) | targetB;
+  }
+}
+
+#if defined(USE_X86_BLEND)
+/**
+\internal
+\brief fills the span four pixels at a time. The color multiplied by the
+alpha is the same for each pixel, so only the destination is widened and
+multiplied.
+*/
+__attribute__((target("sse2"))) void
+viewManager::Visualizer::platform::fillSpanSSE2(unsigned int *pixels,
+                                                const int n,
+                                                const unsigned int color,
+                                                const unsigned int alpha) {
+  if (!alpha)
+    return;
+
+  int i = 0;
+  if (alpha >= 255) {
+    const __m128i c = _mm_set1_epi32(static_cast<int>(color & 0x00FFFFFF));
+    for (; i + 4 <= n; i += 4)
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), c);
+  } else {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i inverse = _mm_set1_epi16(static_cast<short>(255 - alpha));
+    const __m128i source = _mm_mullo_epi16(
+        _mm_unpacklo_epi8(
+            _mm_set1_epi32(static_cast<int>(color & 0x00FFFFFF)), zero),
+        _mm_set1_epi16(static_cast<short>(alpha)));
+
+    for (; i + 4 <= n; i += 4) {
+      __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i *>(pixels + i));
+      __m128i low = _mm_srli_epi16(
+          _mm_add_epi16(source,
+                        _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inverse)),
+          8);
+      __m128i high = _mm_srli_epi16(
+          _mm_add_epi16(source,
+                        _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inverse)),
+          8);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i),
+                       _mm_and_si128(_mm_packus_epi16(low, high), colorMask));
+    }
+  }
+
+  fillSpanScalar(pixels + i, n - i, color, alpha);
+}
+
+/**
+\internal
+\brief fills the span eight pixels at a time, as fillSpanSSE2.
+*/
+__attribute__((target("avx2"))) void
+viewManager::Visualizer::platform::fillSpanAVX2(unsigned int *pixels,
+                                                const int n,
+                                                const unsigned int color,
+                                                const unsigned int alpha) {
+  if (!alpha)
+    return;
+
+  int i = 0;
+  if (alpha >= 255) {
+    const __m256i c =
+        _mm256_set1_epi32(static_cast<int>(color & 0x00FFFFFF));
+    for (; i + 8 <= n; i += 8)
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(pixels + i), c);
+  } else {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i colorMask = _mm256_set1_epi32(0x00FFFFFF);
+    const __m256i inverse =
+        _mm256_set1_epi16(static_cast<short>(255 - alpha));
+    const __m256i source = _mm256_mullo_epi16(
+        _mm256_unpacklo_epi8(
+            _mm256_set1_epi32(static_cast<int>(color & 0x00FFFFFF)), zero),
+        _mm256_set1_epi16(static_cast<short>(alpha)));
+
+    for (; i + 8 <= n; i += 8) {
+      __m256i d = _mm256_loadu_si256(reinterpret_cast<__m256i *>(pixels + i));
+      __m256i low = _mm256_srli_epi16(
+          _mm256_add_epi16(
+              source, _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), inverse)),
+          8);
+      __m256i high = _mm256_srli_epi16(
+          _mm256_add_epi16(
+              source, _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), inverse)),
+          8);
+      _mm256_storeu_si256(
+          reinterpret_cast<__m256i *>(pixels + i),
+          _mm256_and_si256(_mm256_packus_epi16(low, high), colorMask));
+    }
+  }
+
+  // the upper halves are cleared before the SSE2 instructions.
+  _mm256_zeroupper();
+  fillSpanSSE2(pixels + i, n - i, color, alpha);
+}
+#endif
+
+/**
+\brief The routine returns that face ID for the cached font. This is a
+pointer to the record within the vector.
+*/
+FTC_FaceID viewManager::Visualizer::platform::getFaceID(string sTextFace) {
+  FTC_FaceID faceID = nullptr;
+
+  auto it = m_faceCache.find(sTextFace);
+  if (it != m_faceCache.end()) {
     faceID = static_cast<FTC_FaceID>(&it->second);
   } else {
     string sFullFontPath = getFontFilename(sTextFace);
@@ -4439,154 +6997,652 @@ FTC_FaceID viewManager::Visualizer::platform::getFaceID(string sTextFace) {
 /**
 \internal
 \brief The function returns the width of the string according to the font
-size.
+size. The width is the advance of the drawing position.
 */
 double viewManager::Visualizer::platform::measureTextWidth(
     const std::string &sTextFace, const int pointSize, const std::string &s) {
-  bool bProcessedOnce = false;
-  FT_Error error;
-  FTC_ScalerRec scaler;
-  FT_Size sizeFace;
-  FT_UInt glyph_index = 0;
-  FT_UInt previous_index = 0;
-  double ret = 0;
+  // store a cache record for loaded fonts.
+  FTC_FaceID faceID = getFaceID(sTextFace);
+  return m_fonts
+      .get(m_cacheManager, m_cmapCache, faceID, pointSize + fontScale)
+      .measure(s);
+}
 
+/**
+\internal
+\brief the function measures the height of the textFace
+\param const std::string &sTextFace the face name
+\param const int pointSize the size in point of the font
+
+*/
+double viewManager::Visualizer::platform::measureFaceHeight(
+    const std::string &sTextFace, const int pointSize) {
   // store a cache record for loaded fonts.
   FTC_FaceID faceID = getFaceID(sTextFace);
+  return m_fonts
+      .get(m_cacheManager, m_cmapCache, faceID, pointSize + fontScale)
+      .faceHeight;
+}
+
+/**
+\internal
+\brief resolves the metrics of the face at the point size. The glyphs are
+loaded for their advance only, they are not rendered. The first 256
+characters, those of Latin-1, are resolved here.
+*/
+viewManager::Visualizer::resolvedFont::resolvedFont(FTC_Manager cacheManager,
+                                                    FTC_CMapCache cmapCache,
+                                                    FTC_FaceID faceID,
+                                                    const int pointSize)
+    : m_cacheManager(cacheManager), m_cmapCache(cmapCache) {
+  FT_Size sizeFace;
 
-  // having this as a local variable
   scaler.face_id = faceID;
   scaler.pixel = 0;
-  scaler.height = (pointSize + fontScale) * 64;
-  scaler.width = (pointSize + fontScale) * 64;
-
+  scaler.height = pointSize * 64;
+  scaler.width = pointSize * 64;
   scaler.x_res = 96;
   scaler.y_res = 96;
 
-  // get the face
-  error = FTC_Manager_LookupSize(m_cacheManager, &scaler, &sizeFace);
-
-  if (error)
+  if (FTC_Manager_LookupSize(cacheManager, &scaler, &sizeFace))
     throw std::runtime_error("Could not retrieve font face.");
 
-  error = FT_Activate_Size(sizeFace);
-  if (error)
+  if (FT_Activate_Size(sizeFace))
     throw std::runtime_error("Could FT_Activate_Size for font.");
 
   FT_Face face = sizeFace->face;
+  faceHeight = face->size->metrics.height >> 6;
+  bKerning = FT_HAS_KERNING(face);
+
+  // several characters share the missing glyph, each glyph is loaded once.
+  std::unordered_map<FT_UInt, int> loaded;
+  for (int c = 0; c < 256; c++) {
+    FT_UInt glyph = FTC_CMapCache_Lookup(cmapCache, faceID, 0, c);
+    m_glyphs[c] = glyph;
+
+    auto it = loaded.find(glyph);
+    if (it == loaded.end()) {
+      int advance = 0;
+      if (!FT_Load_Glyph(face, glyph, FT_LOAD_DEFAULT))
+        advance = (face->glyph->advance.x + 32) >> 6;
+      it = loaded.insert({glyph, advance}).first;
+    }
+    m_advances[c] = it->second;
+  }
+
+  // the drawing moves to the tab stop and starts a new line without an
+  // advance.
+  m_advances['\t'] = tabWidth;
+  m_advances['\n'] = 0;
+}
+
+/**
+\internal
+\brief returns the width of the string, the advance of the drawing
+position over its shaped run.
+*/
+double
+viewManager::Visualizer::resolvedFont::measure(const std::string_view &s) {
+  return shape(s).width;
+}
 
-  // iterate characters in string
-  for (auto &c : s) {
+/**
+\internal
+\brief returns the shaped run of the text. A run shaped before is found by
+the hash of the text, and becomes the most recently used. When the font
+holds runCapacity runs, the least recently used is removed. The reference
+is valid until another string is shaped.
+*/
+const viewManager::Visualizer::resolvedFont::shapedRun &
+viewManager::Visualizer::resolvedFont::shape(const std::string_view &s) {
+  std::uint64_t key = 14695981039346656037ull;
+  for (auto c : s)
+    key = (key ^ static_cast<u_int8_t>(c)) * 1099511628211ull;
+
+  auto it = m_runIndex.find(key);
+  if (it != m_runIndex.end()) {
+    if (it->second->text == s) {
+      if (it->second != m_runs.begin())
+        m_runs.splice(m_runs.begin(), m_runs, it->second);
+      return m_runs.front();
+    }
+
+    // another text with the same hash is replaced.
+    m_runs.erase(it->second);
+    m_runIndex.erase(it);
+  }
+
+  while (m_runs.size() >= runCapacity) {
+    m_runIndex.erase(m_runs.back().key);
+    m_runs.pop_back();
+  }
+
+  m_runs.push_front({key, std::string(s), {}, 0});
+  shapeRun(s, m_runs.front());
+  m_runIndex[key] = m_runs.begin();
+  return m_runs.front();
+}
+
+#ifdef USE_HARFBUZZ
+/**
+\internal
+\brief shapes the text using HarfBuzz. The text between the new lines and
+tabs is shaped as a segment, the direction and script are guessed from its
+characters. The positions are rounded to pixels as the pen moves, so the
+advances sum to the width of the run. The hinted advances are used, as
+the glyphs are drawn hinted. The HarfBuzz font is made for each run since
+the face may be released by the cache between runs.
+*/
+void viewManager::Visualizer::resolvedFont::shapeRun(
+    const std::string_view &s, shapedRun &run) {
+  FT_Size sizeFace;
+  if (FTC_Manager_LookupSize(m_cacheManager, &scaler, &sizeFace) ||
+      FT_Activate_Size(sizeFace))
+    return;
+
+  hb_font_t *font = hb_ft_font_create(sizeFace->face, nullptr);
+  hb_ft_font_set_load_flags(font, FT_LOAD_DEFAULT);
+  hb_buffer_t *buffer = hb_buffer_create();
+
+  // the position of the pen in 26.6 pixels.
+  hb_position_t pen = 0;
+  std::size_t begin = 0;
+  while (begin <= s.size()) {
+    std::size_t end = s.find_first_of("\n\t", begin);
+    if (end == s.npos)
+      end = s.size();
+
+    if (end > begin) {
+      hb_buffer_reset(buffer);
+      hb_buffer_add_utf8(buffer, s.data(), static_cast<int>(s.size()),
+                         static_cast<unsigned int>(begin),
+                         static_cast<int>(end - begin));
+      hb_buffer_guess_segment_properties(buffer);
+      hb_shape(font, buffer, nullptr, 0);
+
+      unsigned int count;
+      hb_glyph_info_t *info = hb_buffer_get_glyph_infos(buffer, &count);
+      hb_glyph_position_t *position =
+          hb_buffer_get_glyph_positions(buffer, &count);
+      for (unsigned int i = 0; i < count; i++) {
+        int before = (pen + 32) >> 6;
+        pen += position[i].x_advance;
+        run.glyphs.push_back({info[i].codepoint, 0,
+                              (position[i].x_offset + 32) >> 6,
+                              (position[i].y_offset + 32) >> 6,
+                              ((pen + 32) >> 6) - before, 0});
+      }
+    }
 
-    // handle special characters
-    if (c == '\t') {
-      m_xpos += 50;
+    if (end == s.size())
+      break;
+
+    int advance = m_advances[static_cast<unsigned char>(s[end])];
+    run.glyphs.push_back({0, 0, 0, 0, advance, s[end]});
+    pen += advance * 64;
+    begin = end + 1;
+  }
+
+  hb_buffer_destroy(buffer);
+  hb_font_destroy(font);
+  run.width = (pen + 32) >> 6;
+}
+
+#else
+/**
+\internal
+\brief shapes the text one glyph for each character. The kerning of the
+face is applied between the glyphs, a new line or a tab between them does
+not reset it.
+*/
+void viewManager::Visualizer::resolvedFont::shapeRun(
+    const std::string_view &s, shapedRun &run) {
+  FT_UInt previous = 0;
+  bool bProcessedOnce = false;
+  int width = 0;
+
+  for (std::size_t i = 0; i < s.size();) {
+    char32_t c = decode(s, i);
+    if (c == '\n' || c == '\t') {
+      run.glyphs.push_back({0, 0, 0, 0, m_advances[c], static_cast<char>(c)});
+      width += m_advances[c];
       continue;
     }
 
-    FT_UInt glyph_index = 0;
+    std::pair<FT_UInt, int> glyph = character(c);
+    int kern =
+        bKerning && bProcessedOnce ? kerning(previous, glyph.first) : 0;
+    run.glyphs.push_back({glyph.first, kern, 0, 0, glyph.second, 0});
+    width += kern + glyph.second;
+    previous = glyph.first;
+    bProcessedOnce = true;
+  }
 
-    // get the index of the glyph
-    glyph_index = FTC_CMapCache_Lookup(m_cmapCache, faceID, 0, c);
+  run.width = width;
+}
+#endif
 
-    // the kerning of a font depends on the previous character
-    // some proportional fonts provide tighter spacing which improves
-    // rendering characteristics
-    if (FT_HAS_KERNING(face) && bProcessedOnce) {
-      FT_Vector akerning;
-      error = FT_Get_Kerning(face, previous_index, glyph_index,
-                             FT_KERNING_DEFAULT, &akerning);
-      if (!error) {
-        m_xpos += akerning.x >> 6;
+/**
+\internal
+\brief returns the glyph index and the advance of the character. Those
+beyond the first 256 are resolved the first time they are used.
+*/
+std::pair<FT_UInt, int>
+viewManager::Visualizer::resolvedFont::character(const char32_t c) {
+  if (c < 256)
+    return {m_glyphs[c], m_advances[c]};
+
+  auto it = m_characters.find(c);
+  if (it != m_characters.end())
+    return it->second;
+
+  FT_UInt glyph = FTC_CMapCache_Lookup(m_cmapCache, scaler.face_id, 0, c);
+  int advance = 0;
+  FT_Size sizeFace;
+  if (!FTC_Manager_LookupSize(m_cacheManager, &scaler, &sizeFace) &&
+      !FT_Activate_Size(sizeFace) &&
+      !FT_Load_Glyph(sizeFace->face, glyph, FT_LOAD_DEFAULT))
+    advance = (sizeFace->face->glyph->advance.x + 32) >> 6;
+
+  return m_characters.insert({c, {glyph, advance}}).first->second;
+}
+
+/**
+\internal
+\brief decodes the UTF-8 character at the position and moves past it. A
+byte that does not begin a well formed character, an overlong form, a
+surrogate or a value beyond the Unicode range is one replacement
+character.
+*/
+char32_t viewManager::Visualizer::resolvedFont::decode(const std::string_view &s,
+                                                       std::size_t &i) {
+  u_int8_t c = static_cast<u_int8_t>(s[i]);
+  if (c < 0x80) {
+    i++;
+    return c;
+  }
+
+  std::size_t length;
+  char32_t ret, minimum;
+  if ((c & 0xE0) == 0xC0) {
+    length = 2;
+    ret = c & 0x1F;
+    minimum = 0x80;
+  } else if ((c & 0xF0) == 0xE0) {
+    length = 3;
+    ret = c & 0x0F;
+    minimum = 0x800;
+  } else if ((c & 0xF8) == 0xF0) {
+    length = 4;
+    ret = c & 0x07;
+    minimum = 0x10000;
+  } else {
+    i++;
+    return 0xFFFD;
+  }
+
+  if (i + length > s.size()) {
+    i++;
+    return 0xFFFD;
+  }
+
+  for (std::size_t k = 1; k < length; k++) {
+    u_int8_t b = static_cast<u_int8_t>(s[i + k]);
+    if ((b & 0xC0) != 0x80) {
+      i++;
+      return 0xFFFD;
+    }
+    ret = (ret << 6) | (b & 0x3F);
+  }
+
+  if (ret < minimum || ret > 0x10FFFF || (ret >= 0xD800 && ret <= 0xDFFF)) {
+    i++;
+    return 0xFFFD;
+  }
+
+  i += length;
+  return ret;
+}
+
+/**
+\internal
+\brief returns the kerning, in pixels, between the two glyphs. The face is
+only consulted the first time a pair is used.
+*/
+int viewManager::Visualizer::resolvedFont::kerning(const FT_UInt previous,
+                                                   const FT_UInt glyph) {
+  std::uint64_t key = (static_cast<std::uint64_t>(previous) << 32) | glyph;
+  auto it = m_kerning.find(key);
+  if (it != m_kerning.end())
+    return it->second;
+
+  int ret = 0;
+  FT_Size sizeFace;
+  if (!FTC_Manager_LookupSize(m_cacheManager, &scaler, &sizeFace) &&
+      !FT_Activate_Size(sizeFace)) {
+    FT_Vector akerning;
+    if (!FT_Get_Kerning(sizeFace->face, previous, glyph, FT_KERNING_DEFAULT,
+                        &akerning))
+      ret = akerning.x >> 6;
+  }
+  m_kerning.insert({key, ret});
+  return ret;
+}
+
+/**
+\internal
+\brief returns the resolved font of the face at the point size, creating
+it the first time.
+*/
+viewManager::Visualizer::resolvedFont &
+viewManager::Visualizer::resolvedFontCache::get(FTC_Manager cacheManager,
+                                                FTC_CMapCache cmapCache,
+                                                FTC_FaceID faceID,
+                                                const int pointSize) {
+  if (m_last && faceID == m_lastFaceID && pointSize == m_lastPointSize)
+    return *m_last;
+
+  std::unique_ptr<resolvedFont> &font = m_fonts[{faceID, pointSize}];
+  if (!font)
+    font = std::make_unique<resolvedFont>(cacheManager, cmapCache, faceID,
+                                          pointSize);
+  m_last = font.get();
+  m_lastFaceID = faceID;
+  m_lastPointSize = pointSize;
+  return *m_last;
+}
+
+/**
+\internal
+\brief encodes the bitmap of the glyph as runs. Each pixel is without
+coverage, opaque or partially covered. As drawn before, a pixel whose
+first coverage byte is zero is not drawn, for the LCD format this is the
+red. Adjacent pixels of the same kind form a run. Runs shorter than
+minimumRun are not worth a fill or a skip, blending them along with their
+neighbours is faster. So a short opaque run is kept as partial coverage,
+and partial runs separated by a short gap are joined. The blending leaves
+the pixels of the gap as they are and gives the opaque pixels the color of
+the fill.
+*/
+viewManager::Visualizer::glyphAtlas::glyph *
+viewManager::Visualizer::glyphAtlas::insert(
+    const FT_UInt glyphIndex, const unsigned char *buffer, const int pitch,
+    const int width, const int height, const int storageSize, const int left,
+    const int top, const int xadvance) {
+  glyph &g = m_glyphs[glyphIndex];
+  g = {true,  static_cast<std::uint32_t>(m_runs.size()), 0, left, top, width,
+       height, xadvance};
+
+  std::vector<std::uint32_t> coverage(width);
+  std::vector<std::tuple<int, int, bool>> rowRuns;
+  for (int q = 0; q < height; q++) {
+    const unsigned char *row = buffer + q * pitch;
+    for (int p = 0; p < width; p++, row += storageSize) {
+      if (storageSize == 1)
+        coverage[p] = row[0] * 0x010101u;
+      else
+        coverage[p] = (row[0] << 16) | (row[1] << 8) | row[2];
+    }
+
+    // the runs of the row as begin, end and whether opaque.
+    rowRuns.clear();
+    int p = 0;
+    while (p < width) {
+      if (!(coverage[p] & 0xFF0000)) {
+        p++;
+        continue;
       }
+
+      bool bOpaque = coverage[p] == 0xFFFFFF;
+      int begin = p;
+      while (p < width && (coverage[p] & 0xFF0000) &&
+             (coverage[p] == 0xFFFFFF) == bOpaque)
+        p++;
+
+      if (p - begin < minimumRun)
+        bOpaque = false;
+      if (!bOpaque && !rowRuns.empty() && !std::get<2>(rowRuns.back()) &&
+          begin - std::get<1>(rowRuns.back()) < minimumRun)
+        std::get<1>(rowRuns.back()) = p;
+      else
+        rowRuns.push_back({begin, p, bOpaque});
     }
 
-    // render the character
-    /**
-    \brief use greyscale or color lcd filtering
-  \details
-        There are two distinct types of bimap structures that are in use,
-  grey scale or lcd filtered. The buffer format is unique for each, the grey
-    lite one being a value indicating grey luminence while the lcd filter is
-  a rgb one. These values provide the same functionality for the looping and
-        drawing routine. You will notice that within each block of code,
-  after getting the image, these values are set.
-    */
-    int xadvance;
+    for (auto &n : rowRuns) {
+      int begin = std::get<0>(n);
+      int end = std::get<1>(n);
+      bool bOpaque = std::get<2>(n);
+      m_runs.push_back((static_cast<std::uint32_t>(q) << 16) |
+                       static_cast<std::uint32_t>(begin));
+      m_runs.push_back((static_cast<std::uint32_t>(end - begin) << 1) |
+                       (bOpaque ? opaque : 0));
+      if (!bOpaque)
+        m_runs.insert(m_runs.end(), coverage.begin() + begin,
+                      coverage.begin() + end);
+      g.runs++;
+    }
+  }
 
-#ifdef USE_GREYSCALE_ANTIALIAS
-    // get the image
-    FTC_SBit bitmap;
-    error = FTC_SBitCache_LookupScaler(m_bitCache, &scaler, FT_LOAD_RENDER,
-                                       glyph_index, &bitmap, nullptr);
+  return &g;
+}
+
+/**
+\internal
+\brief returns the atlas of the face at the scaled size, creating it the
+first time. The atlas is noted as used by the current frame.
+*/
+viewManager::Visualizer::glyphAtlas &
+viewManager::Visualizer::glyphAtlasCache::get(const FTC_Scaler scaler) {
+  if (m_last && scaler->face_id == m_lastScaler.face_id &&
+      scaler->width == m_lastScaler.width &&
+      scaler->height == m_lastScaler.height) {
+    m_last->lastUsed = m_frame;
+    return *m_last;
+  }
+
+  std::unique_ptr<glyphAtlas> &atlas =
+      m_atlases[{scaler->face_id, scaler->width, scaler->height}];
+  if (!atlas)
+    atlas = std::make_unique<glyphAtlas>();
+  m_last = atlas.get();
+  m_last->lastUsed = m_frame;
+  m_lastScaler = *scaler;
+  return *m_last;
+}
+
+/**
+\internal
+\brief the memory held by the atlases.
+*/
+std::size_t viewManager::Visualizer::glyphAtlasCache::bytes(void) {
+  std::size_t ret = 0;
+  for (auto &n : m_atlases)
+    ret += n.second->bytes();
+  return ret;
+}
+
+/**
+\internal
+\brief removes the least recently used atlases while they hold more than
+the budget. The atlases drawn from in the last frame are kept. This is
+done between frames, when no glyph of an atlas is being drawn.
+*/
+void viewManager::Visualizer::glyphAtlasCache::trim(void) {
+  std::size_t total = bytes();
+  if (total > budget) {
+    typedef decltype(m_atlases)::iterator atlasIterator;
+    std::vector<atlasIterator> stale;
+    for (auto it = m_atlases.begin(); it != m_atlases.end(); it++)
+      if (it->second->lastUsed != m_frame)
+        stale.push_back(it);
+    std::sort(stale.begin(), stale.end(),
+              [](const atlasIterator &a, const atlasIterator &b) {
+                return a->second->lastUsed < b->second->lastUsed;
+              });
+
+    for (auto it : stale) {
+      if (total <= budget)
+        break;
+      total -= it->second->bytes();
+      evictions += it->second->size();
+      if (it->second.get() == m_last)
+        m_last = nullptr;
+      m_atlases.erase(it);
+    }
+  }
+  m_frame++;
+}
 
-    if (error)
-      continue;
+/**
+\internal
+\brief creates the FreeType library and caches of the context. The faces
+are opened using the face requestor of the platform.
+*/
+viewManager::Visualizer::fontContext::fontContext() : fontScale(0) {
+  const char *errText = "The freetype library could not be initialized.";
+  FT_Error error;
 
-    xadvance = bitmap->xadvance;
+  error = FT_Init_FreeType(&m_freeType);
+  if (error)
+    throw std::runtime_error(errText);
 
-#elif defined USE_LCD_FILTER
-    FT_Glyph aglyph;
-    FT_BitmapGlyph bitmap;
+  error = FTC_Manager_New(m_freeType, 0, 0, 0, &platform::faceRequestor, NULL,
+                          &m_cacheManager);
+  if (error)
+    throw std::runtime_error(errText);
 
-    // get the image, however this is just the outline
-    error = FTC_ImageCache_LookupScaler(m_imageCache, &scaler, FT_LOAD_DEFAULT,
-                                        glyph_index, &aglyph, nullptr);
-    if (error)
-      continue;
+#ifdef USE_GREYSCALE_ANTIALIAS
+  error = FTC_SBitCache_New(m_cacheManager, &m_bitCache);
+  if (error)
+    throw std::runtime_error(errText);
 
-    xadvance = (aglyph->advance.x + 0x8000) >> 16;
+#elif defined USE_LCD_FILTER
+  error = FTC_ImageCache_New(m_cacheManager, &m_imageCache);
+  if (error)
+    throw std::runtime_error(errText);
 
 #endif
 
-    // move after render
-    ret += xadvance;
-    bProcessedOnce = true;
-    previous_index = glyph_index;
-  }
-  return ret;
+  error = FTC_CMapCache_New(m_cacheManager, &m_cmapCache);
+  if (error)
+    throw std::runtime_error(errText);
+}
+
+viewManager::Visualizer::fontContext::~fontContext() {
+  FTC_Manager_Done(m_cacheManager);
+  FT_Done_FreeType(m_freeType);
 }
 
 /**
 \internal
-\brief the function measures the height of the textFace
-\param const std::string &sTextFace the face name
-\param const int pointSize the size in point of the font
+\brief measures the height of the face, as platform::measureFaceHeight.
+*/
+double viewManager::Visualizer::fontContext::measureFaceHeight(
+    FTC_FaceID faceID, const int pointSize) {
+  return m_fonts
+      .get(m_cacheManager, m_cmapCache, faceID, pointSize + fontScale)
+      .faceHeight;
+}
 
+/**
+\internal
+\brief measures the width of a word. The width is taken from the word
+cache when the word was measured before at the face and point size.
 */
-double viewManager::Visualizer::platform::measureFaceHeight(
-    const std::string &sTextFace, const int pointSize) {
-  FT_Error error;
-  FTC_ScalerRec scaler;
-  FT_Size sizeFace;
+double viewManager::Visualizer::fontContext::measureWordWidth(
+    FTC_FaceID faceID, const int pointSize, const std::string_view &s) {
+  int scaledSize = pointSize + fontScale;
+  double width;
+  if (words.find(faceID, scaledSize, s, width))
+    return width;
+
+  width = m_fonts.get(m_cacheManager, m_cmapCache, faceID, scaledSize)
+              .measure(s);
+  words.insert(faceID, scaledSize, s, width);
+  return width;
+}
 
-  // store a cache record for loaded fonts.
-  FTC_FaceID faceID = getFaceID(sTextFace);
+/**
+\internal
+\brief the key of a word within the cache, a hash of the face, the point
+size and the bytes of the word.
+*/
+std::uint64_t
+viewManager::Visualizer::wordWidthCache::key(FTC_FaceID faceID,
+                                             const int pointSize,
+                                             const std::string_view &s) {
+  std::uint64_t h = 14695981039346656037ull;
+  for (auto c : s)
+    h = (h ^ static_cast<u_int8_t>(c)) * 1099511628211ull;
+  h ^= reinterpret_cast<std::uintptr_t>(faceID) + 0x9e3779b97f4a7c15ull +
+       (h << 6) + (h >> 2);
+  h ^= static_cast<std::uint64_t>(pointSize) + 0x9e3779b97f4a7c15ull +
+       (h << 6) + (h >> 2);
+  return h;
+}
 
-  // having this as a local variable
-  scaler.face_id = faceID;
-  scaler.pixel = 0;
-  scaler.height = (pointSize + fontScale) * 64;
-  scaler.width = (pointSize + fontScale) * 64;
+/**
+\internal
+\brief finds the width of the word. When found, the word becomes the most
+recently used. The words of two keys that hash the same are compared so
+one is never answered for the other.
+*/
+bool viewManager::Visualizer::wordWidthCache::find(FTC_FaceID faceID,
+                                                   const int pointSize,
+                                                   const std::string_view &s,
+                                                   double &width) {
+  auto it = m_index.find(key(faceID, pointSize, s));
+  if (it == m_index.end() || it->second->faceID != faceID ||
+      it->second->pointSize != pointSize || it->second->word != s) {
+    misses++;
+    return false;
+  }
 
-  scaler.x_res = 96;
-  scaler.y_res = 96;
+  if (it->second != m_entries.begin())
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+  width = it->second->width;
+  hits++;
+  return true;
+}
 
-  // get the face
-  error = FTC_Manager_LookupSize(m_cacheManager, &scaler, &sizeFace);
+/**
+\internal
+\brief adds the width of the word as the most recently used. When the
+cache holds its capacity, the least recently used words are removed.
+*/
+void viewManager::Visualizer::wordWidthCache::insert(FTC_FaceID faceID,
+                                                     const int pointSize,
+                                                     const std::string_view &s,
+                                                     const double width) {
+  if (capacity == 0)
+    return;
 
-  if (error)
-    throw std::runtime_error("Could not retrieve font face.");
+  std::uint64_t k = key(faceID, pointSize, s);
+  auto it = m_index.find(k);
+  if (it != m_index.end()) {
+    m_entries.erase(it->second);
+    m_index.erase(it);
+  }
 
-  error = FT_Activate_Size(sizeFace);
-  if (error)
-    throw std::runtime_error("Could FT_Activate_Size for font.");
+  while (m_entries.size() >= capacity) {
+    m_index.erase(m_entries.back().key);
+    m_entries.pop_back();
+    evictions++;
+  }
 
-  FT_Face face = sizeFace->face;
+  m_entries.push_front({k, faceID, pointSize, std::string(s), width});
+  m_index[k] = m_entries.begin();
+}
 
-  // get the height of the font
-  int faceHeight = face->size->metrics.height >> 6;
-  return static_cast<double>(faceHeight);
+/**
+\internal
+\brief measures the width of the text, as platform::measureTextWidth.
+*/
+double viewManager::Visualizer::fontContext::measureTextWidth(
+    FTC_FaceID faceID, const int pointSize, const std::string &s) {
+  return m_fonts
+      .get(m_cacheManager, m_cmapCache, faceID, pointSize + fontScale)
+      .measure(s);
 }
 
 /**
@@ -4596,17 +7652,189 @@ double viewManager::Visualizer::platform::measureFaceHeight(
 void viewManager::Visualizer::platform::drawCaret(const int x, const int y,
                                                   const int h) {
   for (int j = y; j < y + h; j++)
-    putPixel(x, j, 0x00);
+    putPixel(x - m_originX, j - m_originY, 0x00);
+}
+
+/**
+\internal
+\brief sets the position of the document that is drawn at the upper left
+of the surface. The coordinates given to the drawing functions are moved
+by it.
+*/
+void viewManager::Visualizer::platform::setOrigin(const int x, const int y) {
+  m_originX = x;
+  m_originY = y;
+}
+
+/**
+\internal
+\brief limits the drawing to the rectangle, given in surface coordinates.
+The rectangle is kept within the surface.
+*/
+void viewManager::Visualizer::platform::setClip(int x1, int y1, int x2,
+                                                int y2) {
+  m_clipX1 = std::max(x1, 0);
+  m_clipY1 = std::max(y1, 0);
+  m_clipX2 = std::min(x2, static_cast<int>(_w));
+  m_clipY2 = std::min(y2, static_cast<int>(_h));
+}
+
+/**
+\internal
+\brief allows drawing on the whole of the surface.
+*/
+void viewManager::Visualizer::platform::resetClip(void) {
+  m_clipX1 = 0;
+  m_clipY1 = 0;
+  m_clipX2 = _w;
+  m_clipY2 = _h;
 }
 
 /**
 \internal
-\brief the function clears the dirty rectangles of the off screen buffer.
+\brief the function clears the off screen buffer, all of it is damaged.
 */
 void viewManager::Visualizer::platform::clear(void) {
-  fill(m_offscreenBuffer.begin(), m_offscreenBuffer.end(), 0xFF);
+  std::fill(m_pixels, m_pixels + _w * _h * 4, 0xFF);
   m_xpos = 0;
   m_ypos = 0;
+  damage.clear();
+  invalidate(0, 0, _w, _h);
+}
+
+/**
+\internal
+\brief clears the rectangle of the off screen buffer to white. The
+rectangle is within the surface. While painting is recorded, the clearing
+is as well.
+*/
+void viewManager::Visualizer::platform::clear(const int x1, const int y1,
+                                              const int x2, const int y2) {
+  if (x1 >= x2 || y1 >= y2)
+    return;
+
+  paintCommand c = {paintCommand::clearing, nullptr, {}, 0, 0, x1, y1, x2,
+                    y2, 0, 0};
+  if (m_bRecording)
+    m_commands.push_back(c);
+  else
+    paint(c, x1, y1, x2, y2);
+}
+
+/**
+\internal
+\brief notes the rectangle, in surface coordinates, as damaged. The part
+outside of the surface is ignored.
+*/
+void viewManager::Visualizer::platform::invalidate(int x1, int y1, int x2,
+                                                   int y2) {
+  damage.add(std::max(x1, 0), std::max(y1, 0),
+             std::min(x2, static_cast<int>(_w)),
+             std::min(y2, static_cast<int>(_h)));
+}
+
+/**
+\internal
+\brief moves the pixels within the rectangle, in surface coordinates, by
+dx and dy. The rows are copied in the order that reads each before it is
+written. The pixels moved outside of the rectangle are dropped, and the
+band they uncover is damaged. The moved part is sent to the display by
+present without being painted. The damage and the moved pixels noted
+within the rectangle move as well, they remain noted where they were.
+*/
+void viewManager::Visualizer::platform::scroll(int x1, int y1, int x2,
+                                               int y2, const int dx,
+                                               const int dy) {
+  x1 = std::max(x1, 0);
+  y1 = std::max(y1, 0);
+  x2 = std::min(x2, static_cast<int>(_w));
+  y2 = std::min(y2, static_cast<int>(_h));
+  if (x1 >= x2 || y1 >= y2 || (!dx && !dy))
+    return;
+
+  if (std::abs(dx) >= x2 - x1 || std::abs(dy) >= y2 - y1) {
+    invalidate(x1, y1, x2, y2);
+    return;
+  }
+
+#if defined(__linux__)
+  if (m_bSharedMemory)
+    restoreBackImage();
+#endif
+
+  unsigned int *pixels = reinterpret_cast<unsigned int *>(m_pixels);
+  std::size_t bytes = static_cast<std::size_t>(x2 - x1 - std::abs(dx)) * 4;
+  int sourceX = x1 + std::max(-dx, 0);
+  int targetX = x1 + std::max(dx, 0);
+  if (dy > 0) {
+    for (int y = y2 - 1; y >= y1 + dy; y--)
+      memmove(pixels + y * _w + targetX, pixels + (y - dy) * _w + sourceX,
+              bytes);
+  } else {
+    for (int y = y1; y < y2 + dy; y++)
+      memmove(pixels + y * _w + targetX, pixels + (y - dy) * _w + sourceX,
+              bytes);
+  }
+
+  auto follow = [=](damageRegion &region) {
+    std::vector<damageRegion::rectangle> noted = region.rectangles();
+    for (auto &r : noted)
+      region.add(std::max(std::max(r.x1, x1) + dx, x1),
+                 std::max(std::max(r.y1, y1) + dy, y1),
+                 std::min(std::min(r.x2, x2) + dx, x2),
+                 std::min(std::min(r.y2, y2) + dy, y2));
+  };
+  follow(damage);
+  follow(moved);
+
+  moved.add(x1 + std::max(dx, 0), y1 + std::max(dy, 0), x2 + std::min(dx, 0),
+            y2 + std::min(dy, 0));
+  // the bands do not overlap, so that they are not joined into their
+  // bounds.
+  if (dy > 0)
+    invalidate(x1, y1, x2, y1 + dy);
+  else if (dy < 0)
+    invalidate(x1, y2 + dy, x2, y2);
+  int bandY1 = y1 + std::max(dy, 0);
+  int bandY2 = y2 + std::min(dy, 0);
+  if (dx > 0)
+    invalidate(x1, bandY1, x1 + dx, bandY2);
+  else if (dx < 0)
+    invalidate(x2 + dx, bandY1, x2, bandY2);
+}
+
+/**
+\internal
+\brief adds the rectangle to the region. The rectangles it overlaps are
+removed and joined with it, the joined rectangle may overlap others so
+they are searched again.
+*/
+void viewManager::Visualizer::damageRegion::add(int x1, int y1, int x2,
+                                                int y2) {
+  if (x1 >= x2 || y1 >= y2)
+    return;
+
+  rectangle r = {x1, y1, x2, y2};
+  for (std::size_t i = 0; i < m_rectangles.size();) {
+    rectangle &o = m_rectangles[i];
+    if (o.x1 < r.x2 && r.x1 < o.x2 && o.y1 < r.y2 && r.y1 < o.y2) {
+      r = {std::min(r.x1, o.x1), std::min(r.y1, o.y1), std::max(r.x2, o.x2),
+           std::max(r.y2, o.y2)};
+      o = m_rectangles.back();
+      m_rectangles.pop_back();
+      i = 0;
+    } else {
+      i++;
+    }
+  }
+  m_rectangles.push_back(r);
+
+  if (m_rectangles.size() > maximumRectangles) {
+    for (auto &o : m_rectangles)
+      r = {std::min(r.x1, o.x1), std::min(r.y1, o.y1), std::max(r.x2, o.x2),
+           std::max(r.y2, o.y2)};
+    m_rectangles.assign(1, r);
+  }
 }
 
 /**
@@ -4619,11 +7847,8 @@ void viewManager::Visualizer::platform::clear(void) {
 */
 void viewManager::Visualizer::platform::putPixel(const int x, const int y,
                                                  const unsigned int color) {
-  if (x < 0 || y < 0)
-    return;
-
-  // clip coordinates
-  if (x >= _w || y >= _h)
+  // clip coordinates, the rectangle is within the surface.
+  if (x < m_clipX1 || y < m_clipY1 || x >= m_clipX2 || y >= m_clipY2)
     return;
 
   // calculate offset
@@ -4631,7 +7856,7 @@ void viewManager::Visualizer::platform::putPixel(const int x, const int y,
 
   // put rgba color
   unsigned int *p =
-      reinterpret_cast<unsigned int *>(&m_offscreenBuffer[offset]);
+      reinterpret_cast<unsigned int *>(&m_pixels[offset]);
   *p = color;
 }
 
@@ -4655,7 +7880,7 @@ unsigned int viewManager::Visualizer::platform::getPixel(const int x,
 
   // put rgba color
   unsigned int *p =
-      reinterpret_cast<unsigned int *>(&m_offscreenBuffer[offset]);
+      reinterpret_cast<unsigned int *>(&m_pixels[offset]);
   return *p;
 }
 
@@ -4667,47 +7892,32 @@ void viewManager::Visualizer::platform::resize(const int w, const int h) {
 
   _w = w;
   _h = h;
+  resetClip();
 
-#if defined(__linux__)
-
-  // free old one if it exists
-  if (m_pix) {
-    xcb_shm_detach(m_connection, m_info.shmseg);
-    shmdt(m_info.shmaddr);
-
-    xcb_free_pixmap(m_connection, m_pix);
+  // the headless surface is the offscreen buffer alone.
+  if (m_bHeadless) {
+    m_offscreenBuffer.resize(_w * _h * 4);
+    m_pixels = m_offscreenBuffer.data();
+    clear();
+    return;
   }
 
-  // Shared memory test.
-  // https://stackoverflow.com/questions/27745131/how-to-use-shm-pixmap-with-xcb?noredirect=1&lq=1
-  xcb_shm_query_version_reply_t *reply;
+#if defined(__linux__)
 
-  reply = xcb_shm_query_version_reply(
-      m_connection, xcb_shm_query_version(m_connection), NULL);
+  // the former images are released once the server is done with them.
+  if (m_images[0].info.shmaddr)
+    releaseImages();
 
-  if (!reply || !reply->shared_pixmaps) {
-    cout << "Could not get a shared memory image." << endl;
-    exit(0);
+  m_bSharedMemory = createImages();
+  m_back = 0;
+  m_presented.clear();
+  if (m_bSharedMemory) {
+    m_pixels = m_images[m_back].info.shmaddr;
+  } else {
+    m_offscreenBuffer.resize(_w * _h * 4);
+    m_pixels = m_offscreenBuffer.data();
   }
 
-  m_info.shmid = shmget(IPC_PRIVATE, _w * _h * 4, IPC_CREAT | 0777);
-  m_info.shmaddr = (uint8_t *)shmat(m_info.shmid, 0, 0);
-
-  m_info.shmseg = xcb_generate_id(m_connection);
-  xcb_shm_attach(m_connection, m_info.shmseg, m_info.shmid, 0);
-  shmctl(m_info.shmid, IPC_RMID, 0);
-
-  m_screenMemoryBuffer = static_cast<uint8_t *>(m_info.shmaddr);
-
-  m_pix = xcb_generate_id(m_connection);
-  xcb_shm_create_pixmap(m_connection, m_pix, m_window, _w, _h,
-                        m_screen->root_depth, m_info.shmseg, 0);
-
-  int _bufferSize = _w * _h * 4;
-
-  if (m_offscreenBuffer.size() < _bufferSize)
-    m_offscreenBuffer.resize(_bufferSize);
-
   // clear to white
   clear();
 
@@ -4723,6 +7933,7 @@ void viewManager::Visualizer::platform::resize(const int w, const int h) {
   int _bufferSize = _w * _h * 4;
   if (m_offscreenBuffer.size() < _bufferSize)
     m_offscreenBuffer.resize(_bufferSize);
+  m_pixels = m_offscreenBuffer.data();
 
   // clear to white
   clear();
@@ -4747,17 +7958,203 @@ void viewManager::Visualizer::platform::resize(const int w, const int h) {
 bool viewManager::Visualizer::platform::filled() { return m_ypos > _h; }
 
 /**
-\brief The function copies the pixel buffer to the screen
+\internal
+\brief prepares the surface for the damaged rectangles to be drawn. With
+a window on Linux, the back image is waited on until the server is done
+with it. The rectangles sent with the other image since are copied from
+it, so that the back image holds the last frame.
+*/
+void viewManager::Visualizer::platform::beginFrame(void) {
+#if defined(__linux__)
+  if (!m_bSharedMemory || damage.empty())
+    return;
+
+  restoreBackImage();
+#endif
+}
+
+#if defined(__linux__)
+/**
+\internal
+\brief creates the two shared memory images of the surface. Returns false
+when the server does not share memory with the program, for instance
+when it runs on another host, the images made so far are released.
+*/
+bool viewManager::Visualizer::platform::createImages(void) {
+  const xcb_query_extension_reply_t *extension =
+      xcb_get_extension_data(m_connection, &xcb_shm_id);
+  if (!extension || !extension->present)
+    return false;
+
+  xcb_shm_query_version_reply_t *reply = xcb_shm_query_version_reply(
+      m_connection, xcb_shm_query_version(m_connection), NULL);
+  if (!reply)
+    return false;
+  free(reply);
+
+  // the completion events of the images are noted by their type.
+  m_completionEvent = extension->first_event + XCB_SHM_COMPLETION;
+
+  for (auto &image : m_images) {
+    image.pending = 0;
+    int shmid = shmget(IPC_PRIVATE, _w * _h * 4, IPC_CREAT | 0777);
+    if (shmid < 0) {
+      releaseImages();
+      return false;
+    }
+
+    void *address = shmat(shmid, 0, 0);
+    image.info.shmid = shmid;
+    image.info.shmseg = xcb_generate_id(m_connection);
+    xcb_generic_error_t *error =
+        address == (void *)-1
+            ? nullptr
+            : xcb_request_check(m_connection,
+                                xcb_shm_attach_checked(m_connection,
+                                                       image.info.shmseg,
+                                                       image.info.shmid, 0));
+    shmctl(shmid, IPC_RMID, 0);
+    if (address == (void *)-1 || error) {
+      if (error) {
+        free(error);
+        shmdt(address);
+      }
+      releaseImages();
+      return false;
+    }
+    image.info.shmaddr = static_cast<uint8_t *>(address);
+
+    // the image shown before the first frame is white.
+    memset(image.info.shmaddr, 0xFF, _w * _h * 4);
+  }
+  return true;
+}
+
+/**
+\internal
+\brief sends the rectangle of the offscreen buffer to the window when the
+memory is not shared. The rows are copied together and sent in as few
+requests as the maximum length of a request allows.
+*/
+void viewManager::Visualizer::platform::putImage(
+    const damageRegion::rectangle &r) {
+  std::size_t bytes = static_cast<std::size_t>(r.x2 - r.x1) * 4;
+  std::size_t maximum =
+      static_cast<std::size_t>(xcb_get_maximum_request_length(m_connection)) *
+          4 -
+      sizeof(xcb_put_image_request_t);
+  int rows = static_cast<int>(std::max<std::size_t>(maximum / bytes, 1));
+
+  for (int y = r.y1; y < r.y2; y += rows) {
+    int n = std::min(rows, r.y2 - y);
+    m_putBuffer.resize(bytes * n);
+    for (int i = 0; i < n; i++)
+      memcpy(m_putBuffer.data() + bytes * i,
+             m_pixels + (static_cast<std::size_t>(y + i) * _w + r.x1) * 4,
+             bytes);
+    xcb_put_image(m_connection, XCB_IMAGE_FORMAT_Z_PIXMAP, m_window,
+                  m_graphics, r.x2 - r.x1, n, r.x1, y, 0,
+                  m_screen->root_depth, bytes * n, m_putBuffer.data());
+  }
+}
+
+/**
+\internal
+\brief waits for the back image and copies the rectangles sent with the
+other image into it. Once done, it is done until the next flip.
+*/
+void viewManager::Visualizer::platform::restoreBackImage(void) {
+  waitForImage(m_images[m_back]);
+  const u_int8_t *front = m_images[1 - m_back].info.shmaddr;
+  for (auto &r : m_presented.rectangles()) {
+    std::size_t bytes = static_cast<std::size_t>(r.x2 - r.x1) * 4;
+    for (int y = r.y1; y < r.y2; y++) {
+      std::size_t offset = (static_cast<std::size_t>(y) * _w + r.x1) * 4;
+      memcpy(m_pixels + offset, front + offset, bytes);
+    }
+  }
+  m_presented.clear();
+}
+
+/**
+\internal
+\brief waits for the server to complete the requests that read the image.
+The other events received meanwhile are kept for the message loop. When
+the connection is lost, there is nothing to wait for.
+*/
+void viewManager::Visualizer::platform::waitForImage(sharedImage &image) {
+  while (image.pending) {
+    xcb_generic_event_t *e = xcb_wait_for_event(m_connection);
+    if (!e) {
+      image.pending = 0;
+      break;
+    }
+
+    if ((e->response_type & ~0x80) != m_completionEvent) {
+      m_pendingEvents.push_back(e);
+      continue;
+    }
+
+    auto *completion = reinterpret_cast<xcb_shm_completion_event_t *>(e);
+    for (auto &n : m_images)
+      if (n.info.shmseg == completion->shmseg && n.pending)
+        n.pending--;
+    free(e);
+  }
+}
+
+/**
+\internal
+\brief detaches and releases the shared memory of the images, once the
+server is done with them.
+*/
+void viewManager::Visualizer::platform::releaseImages(void) {
+  for (auto &image : m_images) {
+    if (!image.info.shmaddr)
+      continue;
+    waitForImage(image);
+    xcb_shm_detach(m_connection, image.info.shmseg);
+    shmdt(image.info.shmaddr);
+    image.info.shmaddr = nullptr;
+  }
+}
+
+/**
+\internal
+\brief returns the next event, those kept while waiting for an image
+first.
+*/
+xcb_generic_event_t *viewManager::Visualizer::platform::nextEvent(void) {
+  if (m_pendingEvents.empty())
+    return xcb_wait_for_event(m_connection);
+
+  xcb_generic_event_t *e = m_pendingEvents.front();
+  m_pendingEvents.pop_front();
+  return e;
+}
+#endif
+
+/**
+\brief The function sends the image last drawn to the screen, as a whole.
 
 */
 void viewManager::Visualizer::platform::flip() {
+  if (m_bHeadless)
+    return;
+
 #if defined(__linux__)
-  // copy offscreen data to the shared memory video buffer
-  memcpy(m_screenMemoryBuffer, m_offscreenBuffer.data(),
-         m_offscreenBuffer.size());
+  if (!m_bSharedMemory) {
+    putImage({0, 0, static_cast<int>(_w), static_cast<int>(_h)});
+    xcb_flush(m_connection);
+    return;
+  }
 
-  // blit the shared memory buffer
-  xcb_copy_area(m_connection, m_pix, m_window, m_graphics, 0, 0, 0, 0, _w, _h);
+  // the image shown is complete, it is sent again as a whole.
+  sharedImage &front = m_images[1 - m_back];
+  xcb_shm_put_image(m_connection, m_window, m_graphics, _w, _h, 0, 0, _w, _h,
+                    0, 0, m_screen->root_depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 1,
+                    front.info.shmseg, 0);
+  front.pending++;
 
   xcb_flush(m_connection);
 
@@ -4798,3 +8195,60 @@ void viewManager::Visualizer::platform::flip() {
 
 #endif
 }
+
+/**
+\brief The function sends the damaged rectangles of the back image to the
+window, the pixels are read by the server from the shared memory. The
+completion of the last request notes that the server is done with the
+image. The other image becomes the back one. Without shared memory, the
+rectangles of the offscreen buffer are put to the window.
+*/
+void viewManager::Visualizer::platform::flip(const damageRegion &region) {
+  if (m_bHeadless || region.empty())
+    return;
+
+#if defined(__linux__)
+  if (!m_bSharedMemory) {
+    for (auto &r : region.rectangles())
+      putImage(r);
+    xcb_flush(m_connection);
+    return;
+  }
+
+  sharedImage &back = m_images[m_back];
+  const std::vector<damageRegion::rectangle> &rectangles =
+      region.rectangles();
+  for (std::size_t i = 0; i < rectangles.size(); i++) {
+    const damageRegion::rectangle &r = rectangles[i];
+    bool bLast = i + 1 == rectangles.size();
+    xcb_shm_put_image(m_connection, m_window, m_graphics, _w, _h, r.x1, r.y1,
+                      r.x2 - r.x1, r.y2 - r.y1, r.x1, r.y1,
+                      m_screen->root_depth, XCB_IMAGE_FORMAT_Z_PIXMAP, bLast,
+                      back.info.shmseg, 0);
+  }
+  back.pending++;
+
+  xcb_flush(m_connection);
+
+  m_presented = region;
+  m_back = 1 - m_back;
+  m_pixels = m_images[m_back].info.shmaddr;
+
+#elif defined(_WIN64)
+  // the bitmap is created from the whole of the buffer.
+  flip();
+#endif
+}
+
+/**
+\internal
+\brief sends the damage painted and the pixels moved to the display, the
+two regions are emptied.
+*/
+void viewManager::Visualizer::platform::present(void) {
+  for (auto &r : damage.rectangles())
+    moved.add(r.x1, r.y1, r.x2, r.y2);
+  flip(moved);
+  moved.clear();
+  damage.clear();
+}
@@ -47,12 +47,29 @@ against the USE_GREYSCALE_ANTIALIAS option. One one should be defined.
 */
 //#define USE_LCD_FILTER
 
+/**
+\def USE_HARFBUZZ
+\brief The text is shaped using the HarfBuzz library, which provides the
+ligatures, marks and kerning tables of OpenType fonts. The makefile defines
+it when pkg-config finds harfbuzz and links its libraries. Otherwise, the
+characters are mapped to glyphs one for one with the kerning of the face.
+*/
+//#define USE_HARFBUZZ
+
 /**
 \def USE_CHROMIUM_EMBEDDED_FRAMEWORK
 \brief The system will be configured to use the CEF system.
 */
 //#define USE_CHROMIUM_EMBEDDED_FRAMEWORK
 
+/**
+\def USE_HEADLESS_PLATFORM
+\brief The Viewer renders a single frame into the offscreen buffer rather
+than opening a window when processEvents is invoked. No display is needed.
+At run time, the same is selected by invoking Viewer::renderFrames.
+*/
+//#define USE_HEADLESS_PLATFORM
+
 /**
 \def INCLUDE_UX
 \brief The system will be configured to include the base set of user interface
@@ -65,6 +82,9 @@ controls.
 #include <algorithm>
 #include <any>
 #include <array>
+#include <atomic>
+#include <bitset>
+#include <chrono>
 #include <cstdint>
 
 #if defined(_WIN64)
@@ -72,31 +92,39 @@ typedef unsigned char u_int8_t;
 #endif
 
 #include <cctype>
+#include <charconv>
 #include <climits>
 #include <cmath>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <future>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <limits>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <regex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <tuple>
 #include <type_traits>
 #include <typeindex>
 #include <typeinfo>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -105,9 +133,24 @@ typedef unsigned char u_int8_t;
 OS SPECIFIC HEADERS
 *************************************/
 
+/**
+\def USE_X86_BLEND
+\brief The glyph coverage is blended into the offscreen buffer using the
+SSE2 or AVX2 instructions, chosen when the program starts by the
+processor it runs on.
+*/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USE_X86_BLEND
+#include <immintrin.h>
+#endif
+
 #if defined(__linux__)
+#include <fcntl.h>
 #include <sys/ipc.h>
+#include <sys/mman.h>
 #include <sys/shm.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <X11/Xlib-xcb.h>
 #include <X11/Xutil.h>
@@ -146,6 +189,11 @@ EXTERN_C IMAGE_DOS_HEADER __ImageBase;
 #include FT_SIZES_H
 #endif
 
+#ifdef USE_HARFBUZZ
+#include <hb-ft.h>
+#include <hb.h>
+#endif
+
 /**
 \namespace viewManager
 
@@ -381,6 +429,63 @@ strToNumericAndEnum(const std::string_view &sListName,
 std::tuple<doubleNF, doubleNF, doubleNF, doubleNF>
 parseQuadCoordinates(const std::string _sOptions);
 
+/**
+\internal
+\enum attributeSlot
+\brief Each attribute class declared with the attribute macros owns a slot.
+The slot is a compile time constant, slotIndex, within the class. It names
+the bit of the presence mask and the position within the dense attribute
+storage of the attributeTable. When an attribute is added, its name must be
+listed here as well as within the table of attributeTable::slotOf.
+*/
+enum class attributeSlot : uint8_t {
+  indexBy,
+  display,
+  position,
+  objectTop,
+  objectLeft,
+  objectHeight,
+  objectWidth,
+  scrollTop,
+  scrollLeft,
+  background,
+  opacity,
+  textFace,
+  textSize,
+  textWeight,
+  textColor,
+  textAlignment,
+  textIndent,
+  tabSize,
+  lineHeight,
+  marginTop,
+  marginLeft,
+  marginBottom,
+  marginRight,
+  paddingTop,
+  paddingLeft,
+  paddingBottom,
+  paddingRight,
+  borderStyle,
+  borderWidth,
+  borderColor,
+  borderRadius,
+  focusIndex,
+  zIndex,
+  listStyleType,
+  windowTitle,
+  count
+};
+
+/**
+\internal
+\def _ATTRIBUTE_SLOT
+\brief declares the slot index of the named attribute class.
+*/
+#define _ATTRIBUTE_SLOT(NAME)                                                  \
+  static constexpr std::size_t slotIndex =                                     \
+      static_cast<std::size_t>(attributeSlot::NAME)
+
 /**
 \internal
 \def _NUMERIC_ATTRIBUTE
@@ -399,6 +504,7 @@ developed.
 #define _NUMERIC_ATTRIBUTE(NAME)                                               \
   using NAME = class NAME {                                                    \
   public:                                                                      \
+    _ATTRIBUTE_SLOT(NAME);                                                     \
     double value;                                                              \
     NAME(const double &_val) : value(_val) {}                                  \
     NAME(const NAME &_val) : value(_val.value) {}                              \
@@ -413,6 +519,7 @@ developed.
 #define _STRING_ATTRIBUTE(NAME)                                                \
   using NAME = class NAME {                                                    \
   public:                                                                      \
+    _ATTRIBUTE_SLOT(NAME);                                                     \
     std::string value;                                                         \
     NAME(const std::string &_val) : value(_val) {}                             \
     NAME(const NAME &_val) : value(_val.value) {}                              \
@@ -427,6 +534,7 @@ developed.
 #define _NUMERIC_WITH_FORMAT_ATTRIBUTE(NAME)                                   \
   using NAME = class NAME : public doubleNF {                                  \
   public:                                                                      \
+    _ATTRIBUTE_SLOT(NAME);                                                     \
     NAME(const double &_val, const numericFormat &_nf)                         \
         : doubleNF(_val, _nf) {}                                               \
     NAME(const doubleNF &_val) : doubleNF(_val) {}                             \
@@ -444,6 +552,7 @@ developed.
 #define _ENUMERATED_ATTRIBUTE(NAME, ...)                                       \
   using NAME = class NAME {                                                    \
   public:                                                                      \
+    _ATTRIBUTE_SLOT(NAME);                                                     \
     enum optionEnum : uint8_t { __VA_ARGS__ };                                 \
     optionEnum value;                                                          \
                                                                                \
@@ -464,6 +573,7 @@ enumerated constant
 #define _NUMERIC_WITH_ENUMERATED_ATTRIBUTE(NAME, ...)                          \
   using NAME = class NAME {                                                    \
   public:                                                                      \
+    _ATTRIBUTE_SLOT(NAME);                                                     \
     enum optionEnum : uint8_t { __VA_ARGS__ };                                 \
     double value;                                                              \
     optionEnum option;                                                         \
@@ -483,6 +593,7 @@ enumerated constant
 #define _COLOR_ATTRIBUTE(NAME)                                                 \
   using NAME = class NAME : public colorNF {                                   \
   public:                                                                      \
+    _ATTRIBUTE_SLOT(NAME);                                                     \
     NAME(const double &_v1, const double &_v2, const double &_v3)              \
         : colorNF(colorFormat::rgb, {_v1, _v2, _v3, 0}) {}                     \
     NAME(const std::string &_colorName) : colorNF(_colorName) {}               \
@@ -506,6 +617,7 @@ enumerated constant
 #define _VECTOR_ATTRIBUTE(NAME)                                                \
   using NAME = class NAME {                                                    \
   public:                                                                      \
+    _ATTRIBUTE_SLOT(NAME);                                                     \
     std::vector<std::string> value;                                            \
     NAME(std::vector<std::string> _val) : value(std::move(_val)) {}            \
   }
@@ -607,6 +719,70 @@ public:
 
 /** @}*/
 
+/**
+\internal
+\brief attributeHasSlot is true for the attribute classes declared with the
+attribute macros. Other types, such as documentState, are stored by their
+type index.
+*/
+template <typename T, typename = void>
+struct attributeHasSlot : std::false_type {};
+template <typename T>
+struct attributeHasSlot<T, std::void_t<decltype(T::slotIndex)>>
+    : std::true_type {};
+
+/**
+\internal
+\class attributeTable
+\brief The attributeTable stores the attributes of an element. The attribute
+classes that own a slot are kept within a dense vector ordered by slot. A
+presence mask notes which slots are set, and the position of a slot within
+the vector is the count of the set bits below it. Lookups of these do not
+hash and do not throw. Types without a slot are kept within an
+unordered_map indexed by the type.
+*/
+class attributeTable {
+public:
+  attributeTable() : m_presence(0) {}
+
+  /// \brief returns a pointer to the attribute or nullptr when not set.
+  template <typename T> T *find(void) {
+    if constexpr (attributeHasSlot<T>::value) {
+      static_assert(T::slotIndex < 64, "the presence mask holds 64 slots.");
+      if (!(m_presence & (uint64_t{1} << T::slotIndex)))
+        return nullptr;
+      return std::any_cast<T>(&m_values[rank(T::slotIndex)]);
+    } else {
+      auto it = m_other.find(std::type_index(typeid(T)));
+      if (it == m_other.end())
+        return nullptr;
+      return std::any_cast<T>(&it->second);
+    }
+  }
+
+  /// \brief notes if the attribute is set.
+  template <typename T> bool contains(void) {
+    if constexpr (attributeHasSlot<T>::value)
+      return m_presence & (uint64_t{1} << T::slotIndex);
+    else
+      return m_other.find(std::type_index(typeid(T))) != m_other.end();
+  }
+
+  void set(const std::any &setting);
+
+  static std::size_t slotOf(const std::type_index &ti);
+
+private:
+  /// \brief the position of the slot within the dense vector.
+  std::size_t rank(const std::size_t slot) const {
+    return std::bitset<64>(m_presence & ((uint64_t{1} << slot) - 1)).count();
+  }
+
+  uint64_t m_presence;
+  std::vector<std::any> m_values;
+  std::unordered_map<std::type_index, std::any> m_other;
+};
+
 /**
  \brief StyleClass provides a way to collect several attributes
  that have a style organized. The name can be applied to an
@@ -615,20 +791,145 @@ public:
 */
 class StyleClass {
 public:
-  std::unordered_map<std::type_index, std::any> attributes;
+  attributeTable attributes;
   StyleClass *self;
+  /// \brief changes each time the attributes are set. Elements compare it
+  /// to know when their computed style should be resolved again.
+  std::size_t version;
 
 public:
-  template <typename... Args> StyleClass(const Args &... args) : self(this) {
+  template <typename... Args>
+  StyleClass(const Args &... args) : self(this), version(0) {
     setValue({args...});
   }
   void setValue(const std::vector<std::any> &attrs) {
-    for (auto &n : attrs) {
-      std::type_index ti = std::type_index(n.type());
-      attributes[ti] = n;
-    }
+    for (auto &n : attrs)
+      attributes.set(n);
+    version++;
   }
 };
+
+/**
+\internal
+\class ComputedStyle
+\brief The ComputedStyle holds the resolved style of an element. The text
+values are inherited from the parent. The attributes of the attached style
+classes are applied in order, followed by the attributes of the element
+itself. The layout and rendering read from this record rather than the
+attributes.
+*/
+class ComputedStyle {
+public:
+  ComputedStyle()
+      : textFace(DEFAULT_TEXTFACE), textSize(DEFAULT_TEXTSIZE),
+        textColor(DEFAULT_TEXTCOLOR), align(textAlignment::left),
+        lineHeight(1.0), disp(display::in_line), pos(position::relative),
+        zIndex(0), bBackground(false), background(0), opacity(1.0),
+        border(borderStyle::none), borderWidth(1.0), borderColor(0),
+        borderRadius(0), generation(0) {}
+
+  void inherit(const ComputedStyle &parent);
+  void apply(attributeTable &attrs);
+  bool operator==(const ComputedStyle &other) const;
+  bool operator!=(const ComputedStyle &other) const {
+    return !(*this == other);
+  }
+
+  // inherited from the parent
+  std::string textFace;
+  double textSize; ///< in points
+  unsigned int textColor;
+  textAlignment::optionEnum align;
+  double lineHeight; ///< multiple of the face height
+
+  // not inherited
+  display::optionEnum disp;
+  position::optionEnum pos;
+  double zIndex;
+  std::optional<doubleNF> left;
+  std::optional<doubleNF> top;
+  std::optional<doubleNF> width;
+  std::optional<doubleNF> height;
+
+  // the box, painted beneath the text. The opacity applies to the
+  // background and the border.
+  bool bBackground;
+  unsigned int background;
+  double opacity; ///< from 0, transparent, to 1
+  borderStyle::optionEnum border;
+  double borderWidth; ///< in pixels
+  unsigned int borderColor;
+  double borderRadius; ///< in pixels
+
+  /// \brief unique among all of the computed styles, it changes only when
+  /// the resolved values change. Children compare it with the one they
+  /// were resolved against.
+  std::size_t generation;
+  static std::size_t lastGeneration;
+};
+
+/**
+\internal
+\class threadPool
+\brief The threadPool provides a fixed set of worker threads used by the
+phases of the layout that process independent items. Each worker owns a
+queue of tasks. run places a group of tasks upon the queue of the calling
+worker and works on tasks until the group completes, while idle workers
+steal from the other end of the queues. When nothing is left to steal,
+the caller of run sleeps until its group completes or more tasks are
+queued. Tasks may call run with their own
+worker number, so recursive work is spread across the workers. The
+calling thread takes part as worker zero, and a task receives a worker
+number less than size() which can select per worker state. The first
+exception raised by a task of the group is rethrown by run.
+*/
+class threadPool {
+public:
+  typedef std::function<void(std::size_t worker)> taskFunction;
+
+  threadPool(std::size_t threads = std::thread::hardware_concurrency());
+  ~threadPool();
+  threadPool(const threadPool &) = delete;
+  threadPool &operator=(const threadPool &) = delete;
+
+  /// \brief the number of workers, including the calling thread.
+  std::size_t size(void) const { return m_threads.size() + 1; }
+
+  void run(const std::vector<taskFunction> &tasks, const std::size_t worker);
+  void parallelFor(
+      const std::size_t count,
+      const std::function<void(std::size_t idx, std::size_t worker)> &fn);
+
+private:
+  typedef struct {
+    std::atomic<std::size_t> pending;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+  } taskGroup;
+
+  typedef struct {
+    const taskFunction *fn;
+    taskGroup *group;
+  } task;
+
+  typedef struct {
+    std::mutex mutex;
+    std::deque<task> tasks;
+  } taskQueue;
+
+  bool takeTask(const std::size_t worker, task &t);
+  void execute(task &t, const std::size_t worker);
+  void workerLoop(const std::size_t worker);
+
+  std::vector<std::unique_ptr<taskQueue>> m_queues;
+  std::vector<std::thread> m_threads;
+  std::atomic<std::size_t> m_queued;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+  bool m_stop;
+};
+
 /**
 \internal
 \namespace Visualizer
@@ -654,6 +955,375 @@ extern std::vector<rectangle> items;
 std::size_t allocate(Element &e);
 void deallocate(const std::size_t &token);
 
+/**
+\internal
+\class resolvedFont
+\brief The resolvedFont holds the metrics of a face at one point size. The
+text is UTF-8, it is shaped into a run of glyphs with their positions that
+both the measure and platform::drawText use, so the layout and the drawing
+agree. The runs are kept by their text, a string shaped again is found in
+the cache. The glyph index and advance of the first 256 characters are
+resolved when the font is created, the others the first time they are
+used. The glyphs are loaded for their advance only, they are not
+rendered. The kerning of a pair of glyphs is resolved the first time it is
+used and kept within a hash table.
+*/
+class resolvedFont {
+public:
+  /**
+  \brief a glyph of a shaped run. The kerning moves the drawing position
+  before the glyph is drawn, the offsets place the glyph without moving it
+  and the advance moves it after. The vertical offset is upward. A new line
+  or a tab is noted as the control character, no glyph is drawn for it.
+  */
+  typedef struct {
+    FT_UInt glyph;
+    int kerning;
+    int xOffset;
+    int yOffset;
+    int advance;
+    char control;
+  } shapedGlyph;
+
+  typedef struct {
+    std::uint64_t key;
+    std::string text;
+    std::vector<shapedGlyph> glyphs;
+    int width;
+  } shapedRun;
+
+  resolvedFont(FTC_Manager cacheManager, FTC_CMapCache cmapCache,
+               FTC_FaceID faceID, const int pointSize);
+  double measure(const std::string_view &s);
+  const shapedRun &shape(const std::string_view &s);
+  int kerning(const FT_UInt previous, const FT_UInt glyph);
+  static char32_t decode(const std::string_view &s, std::size_t &i);
+
+  /// \brief the width the drawing advances for a tab.
+  static const int tabWidth = 50;
+
+  /// \brief the number of shaped runs kept by the font.
+  static const std::size_t runCapacity = 4096;
+
+  FTC_ScalerRec scaler;
+  int faceHeight;
+  bool bKerning;
+
+private:
+  void shapeRun(const std::string_view &s, shapedRun &run);
+  std::pair<FT_UInt, int> character(const char32_t c);
+
+  FTC_Manager m_cacheManager;
+  FTC_CMapCache m_cmapCache;
+  std::array<FT_UInt, 256> m_glyphs;
+  std::array<int, 256> m_advances;
+  std::unordered_map<char32_t, std::pair<FT_UInt, int>> m_characters;
+  std::unordered_map<std::uint64_t, int> m_kerning;
+
+  /// \brief the most recently used run is at the front.
+  std::list<shapedRun> m_runs;
+  std::unordered_map<std::uint64_t, std::list<shapedRun>::iterator>
+      m_runIndex;
+};
+
+/**
+\internal
+\brief The resolved fonts of a FreeType cache manager, by face and point
+size. The last one used is found without searching.
+*/
+class resolvedFontCache {
+public:
+  resolvedFontCache()
+      : m_lastFaceID(nullptr), m_lastPointSize(0), m_last(nullptr) {}
+  resolvedFont &get(FTC_Manager cacheManager, FTC_CMapCache cmapCache,
+                    FTC_FaceID faceID, const int pointSize);
+
+private:
+  std::map<std::pair<FTC_FaceID, int>, std::unique_ptr<resolvedFont>>
+      m_fonts;
+  FTC_FaceID m_lastFaceID;
+  int m_lastPointSize;
+  resolvedFont *m_last;
+};
+
+/**
+\internal
+\class wordWidthCache
+\brief The wordWidthCache keeps the measured width of words by face, point
+size and the bytes of the word. The same words are measured many times
+within a document and again on each frame, the cache answers them without
+walking the font. It holds at most capacity words, the least recently used
+is removed when a new one is added. The counters note the lookups answered
+and those that were measured, they are used to size the capacity.
+*/
+class wordWidthCache {
+public:
+  wordWidthCache() : capacity(16384), hits(0), misses(0), evictions(0) {}
+  bool find(FTC_FaceID faceID, const int pointSize, const std::string_view &s,
+            double &width);
+  void insert(FTC_FaceID faceID, const int pointSize,
+              const std::string_view &s, const double width);
+  std::size_t size(void) { return m_entries.size(); }
+
+  std::size_t capacity;
+  std::size_t hits;
+  std::size_t misses;
+  std::size_t evictions;
+
+private:
+  typedef struct {
+    std::uint64_t key;
+    FTC_FaceID faceID;
+    int pointSize;
+    std::string word;
+    double width;
+  } entry;
+  std::uint64_t key(FTC_FaceID faceID, const int pointSize,
+                    const std::string_view &s);
+
+  /// \brief the most recently used word is at the front.
+  std::list<entry> m_entries;
+  std::unordered_map<std::uint64_t, std::list<entry>::iterator> m_index;
+};
+
+/**
+\internal
+\class glyphAtlas
+\brief The glyphAtlas holds the glyphs of a face at one size that have
+been drawn, encoded as runs of coverage within one contiguous vector. Each
+row of a glyph is a sequence of runs, the pixels without coverage are not
+stored. A run is two words, the row and column followed by the length and
+whether it is opaque. A run of partial coverage is followed by the
+coverage of its pixels in the format of platform::blendSpan. An opaque run
+is drawn as a fill of the color. Short gaps and short opaque runs are
+kept within partial runs. The glyph record notes where its runs
+begin within the vector. The records are kept by glyph index as the glyphs
+are drawn, a face may have tens of thousands of glyphs of which few are
+used.
+*/
+class glyphAtlas {
+public:
+  typedef struct {
+    bool bCached;
+    std::uint32_t offset;
+    std::uint32_t runs;
+    int left;
+    int top;
+    int width;
+    int height;
+    int xadvance;
+  } glyph;
+
+  glyphAtlas() : lastUsed(0) {}
+  glyph *find(const FT_UInt glyphIndex) {
+    auto it = m_glyphs.find(glyphIndex);
+    return it != m_glyphs.end() ? &it->second : nullptr;
+  }
+  glyph *insert(const FT_UInt glyphIndex, const unsigned char *buffer,
+                const int pitch, const int width, const int height,
+                const int storageSize, const int left, const int top,
+                const int xadvance);
+  const std::uint32_t *runs(const glyph &g) {
+    return m_runs.data() + g.offset;
+  }
+  std::size_t bytes(void) {
+    return m_runs.capacity() * sizeof(std::uint32_t) +
+           m_glyphs.size() *
+               (sizeof(std::pair<const FT_UInt, glyph>) + 2 * sizeof(void *)) +
+           m_glyphs.bucket_count() * sizeof(void *);
+  }
+  std::size_t size(void) { return m_glyphs.size(); }
+
+  /// \brief the frame the atlas was last drawn from.
+  std::size_t lastUsed;
+
+  /// \brief the run is opaque, every channel is fully covered.
+  static const std::uint32_t opaque = 1;
+
+  /// \brief the fewest pixels of an opaque run or of a gap between runs.
+  static const int minimumRun = 8;
+
+private:
+  std::vector<std::uint32_t> m_runs;
+  std::unordered_map<FT_UInt, glyph> m_glyphs;
+};
+
+/**
+\internal
+\brief The glyph atlases of the platform, by face and scaled size. The
+last one used is found without searching. The glyphs found within the
+atlases and those encoded are counted. Each atlas notes the frame it was
+last drawn from. When the atlases hold more than the budget in bytes
+between frames, the least recently used are removed until they fit. Those
+drawn from in the last frame are kept, their glyphs are likely drawn
+again.
+*/
+class glyphAtlasCache {
+public:
+  glyphAtlasCache()
+      : budget(4 << 20), hits(0), misses(0), evictions(0), m_frame(1),
+        m_last(nullptr), m_lastScaler{} {}
+  glyphAtlas &get(const FTC_Scaler scaler);
+  std::size_t bytes(void);
+  void trim(void);
+
+  std::size_t budget;
+  std::size_t hits;
+  std::size_t misses;
+  std::size_t evictions;
+
+private:
+  std::map<std::tuple<FTC_FaceID, FT_UInt, FT_UInt>,
+           std::unique_ptr<glyphAtlas>>
+      m_atlases;
+  std::size_t m_frame;
+  glyphAtlas *m_last;
+  FTC_ScalerRec m_lastScaler;
+};
+
+/**
+\internal
+\class fontContext
+\brief The fontContext owns a FreeType library along with its cache
+manager, character map and glyph caches. FreeType objects may not be used
+from several threads at once, so each worker of the text measurement phase
+owns one. The face ids are resolved by the platform before the workers
+start and are only read here. The measurement is the same as
+platform::measureTextWidth, both use the resolved fonts.
+*/
+class fontContext {
+public:
+  fontContext();
+  ~fontContext();
+  fontContext(const fontContext &) = delete;
+  fontContext &operator=(const fontContext &) = delete;
+  double measureTextWidth(FTC_FaceID faceID, const int pointSize,
+                          const std::string &s);
+  double measureWordWidth(FTC_FaceID faceID, const int pointSize,
+                          const std::string_view &s);
+  double measureFaceHeight(FTC_FaceID faceID, const int pointSize);
+  int fontScale;
+  wordWidthCache words;
+
+private:
+  FT_Library m_freeType;
+  FTC_Manager m_cacheManager;
+#ifdef USE_LCD_FILTER
+  FTC_ImageCache m_imageCache;
+#endif
+#ifdef USE_GREYSCALE_ANTIALIAS
+  FTC_SBitCache m_bitCache;
+#endif
+  FTC_CMapCache m_cmapCache;
+  resolvedFontCache m_fonts;
+};
+
+#if defined(__linux__)
+/**
+\internal
+\class fontResolver
+\brief The fontResolver provides the font file of a textFace name for the
+process. One fontconfig configuration is built, the first time a name is
+not known, and is shared by all of the platforms. The names resolved are
+kept in an index file within the user's cache directory along with the
+modification times of the font directories. The index is used while the
+directories are unchanged, so the configuration is not built for names
+that were resolved by an earlier run. The faces named by the application
+may be resolved on another thread at startup using prewarm.
+*/
+class fontResolver {
+public:
+  fontResolver();
+  ~fontResolver();
+  fontResolver(const fontResolver &) = delete;
+  fontResolver &operator=(const fontResolver &) = delete;
+  std::string filename(const std::string &sTextFace);
+  void prewarm(const std::vector<std::string> &faces);
+
+private:
+  std::string resolve(const std::string &sTextFace);
+  std::pair<long, long> modified(const std::string &sDirectory);
+  std::string indexFilename(void);
+  void readIndex(void);
+  void writeIndex(void);
+
+  std::mutex m_mutex;
+  FcConfig *m_config;
+  bool m_bIndexRead;
+  std::unordered_map<std::string, std::string> m_files;
+
+  /// \brief the font directories of the configuration and their
+  /// modification times, seconds and nanoseconds.
+  std::map<std::string, std::pair<long, long>> m_directories;
+  std::future<void> m_prewarm;
+};
+extern fontResolver fontFiles;
+
+/**
+\internal
+\class mappedFontFiles
+\brief The mappedFontFiles holds the font files that the faces are opened
+from, mapped into memory once for the process. The faces of each FreeType
+cache manager, and the faces of one file at several indexes, are opened
+from the same mapping. The number of faces open on a file is counted. A
+file is kept mapped after its last face closes, so a face evicted by a
+cache manager is opened again without reading the file. The pages are
+those of the system's file cache, shared by the processes that use the
+font.
+*/
+class mappedFontFiles {
+public:
+  typedef struct {
+    std::string path;
+    const FT_Byte *data;
+    std::size_t size;
+    std::size_t references;
+  } mappedFile;
+
+  mappedFontFiles() {}
+  ~mappedFontFiles();
+  mappedFontFiles(const mappedFontFiles &) = delete;
+  mappedFontFiles &operator=(const mappedFontFiles &) = delete;
+  mappedFile *acquire(const std::string &sPath);
+  void release(mappedFile *file);
+
+private:
+  std::mutex m_mutex;
+  std::unordered_map<std::string, std::unique_ptr<mappedFile>> m_files;
+};
+extern mappedFontFiles mappedFonts;
+#endif
+
+/**
+\internal
+\class damageRegion
+\brief The damageRegion is the part of the surface that must be painted
+again and sent to the display. It is held as rectangles that do not
+overlap, a rectangle that overlaps those noted is joined with them into
+their bounds. When there are more than maximumRectangles, they are joined
+into one. The rectangles exclude their right and bottom edges.
+*/
+class damageRegion {
+public:
+  typedef struct {
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+  } rectangle;
+  void add(int x1, int y1, int x2, int y2);
+  void clear(void) { m_rectangles.clear(); }
+  bool empty(void) const { return m_rectangles.empty(); }
+  const std::vector<rectangle> &rectangles(void) const {
+    return m_rectangles;
+  }
+
+  static const std::size_t maximumRectangles = 32;
+
+private:
+  std::vector<rectangle> m_rectangles;
+};
+
 /**
 \internal
 \class platform
@@ -666,27 +1336,115 @@ public:
            const unsigned short height);
   ~platform();
   void openWindow(const std::string &sWindowTitle);
+  void openHeadless(void);
   void closeWindow(void);
   void messageLoop(void);
+  void writeImage(const std::string &sFilename);
   inline FTC_FaceID getFaceID(std::string sTextFace);
+
+  /**
+  \brief a line of text and the rectangle it is drawn within, in the
+  coordinates of the document.
+  */
+  typedef struct {
+    std::string_view text;
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+  } textLine;
   void drawText(const std::string &sTextFace, const int pointSize,
-                const std::string &s, const unsigned int foreground, int x1,
+                std::string_view s, const unsigned int foreground, int x1,
                 int y1, int x2, int y2, textAlignment tAlign);
+  void drawTextLines(const std::string &sTextFace, const int pointSize,
+                     const unsigned int foreground,
+                     const std::vector<textLine> &lines);
   inline int drawChar(const int xPos, const int yPos, const int xPos2,
-                      const int yPos2, const char c,
-                      const unsigned int foreground, const FT_UInt glyph_index,
+                      const int yPos2, const unsigned int foreground,
+                      const FT_UInt glyph_index,
                       const FT_Size sizeFace, const FTC_Scaler scaler);
   double measureTextWidth(const std::string &sTextFace, const int pointSize,
                           const std::string &s);
+
+  /**
+  \brief the box of an element, in the coordinates of the document. The
+  background is painted within the border. The alpha, from 0 to 255,
+  applies to both.
+  */
+  typedef struct {
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+    bool bBackground;
+    unsigned int background;
+    borderStyle::optionEnum border;
+    int borderWidth;
+    unsigned int borderColor;
+    int radius;
+    unsigned int alpha;
+  } boxStyle;
+  void drawBox(const boxStyle &box);
   double measureFaceHeight(const std::string &sTextFace, const int pointSize);
 
   void drawCaret(const int x, const int y, const int h);
+  void setOrigin(const int x, const int y);
+  void setClip(int x1, int y1, int x2, int y2);
+  void resetClip(void);
   inline void putPixel(const int x, const int y, const unsigned int color);
   inline unsigned int getPixel(const int x, const int y);
 
+  /**
+  \brief blends the foreground color into a span of pixels. Each coverage
+  value holds the red, green and blue coverage in the byte positions of the
+  pixel. A pixel whose red coverage is zero is left as it is.
+  */
+  typedef void (*blendSpanFunction)(unsigned int *pixels,
+                                    const unsigned int *coverage,
+                                    const int n,
+                                    const unsigned int foreground);
+  static void blendSpanScalar(unsigned int *pixels,
+                              const unsigned int *coverage, const int n,
+                              const unsigned int foreground);
+#if defined(USE_X86_BLEND)
+  static void blendSpanSSE2(unsigned int *pixels, const unsigned int *coverage,
+                            const int n, const unsigned int foreground);
+  static void blendSpanAVX2(unsigned int *pixels, const unsigned int *coverage,
+                            const int n, const unsigned int foreground);
+#endif
+  static blendSpanFunction selectBlendSpan(void);
+  static blendSpanFunction blendSpan;
+
+  /**
+  \brief fills a span of pixels with the color. An alpha below 255 blends
+  the color as blendSpan does for the same coverage of each channel.
+  */
+  typedef void (*fillSpanFunction)(unsigned int *pixels, const int n,
+                                   const unsigned int color,
+                                   const unsigned int alpha);
+  static void fillSpanScalar(unsigned int *pixels, const int n,
+                             const unsigned int color,
+                             const unsigned int alpha);
+#if defined(USE_X86_BLEND)
+  static void fillSpanSSE2(unsigned int *pixels, const int n,
+                           const unsigned int color, const unsigned int alpha);
+  static void fillSpanAVX2(unsigned int *pixels, const int n,
+                           const unsigned int color, const unsigned int alpha);
+#endif
+  static fillSpanFunction selectFillSpan(void);
+  static fillSpanFunction fillSpan;
+
+  void beginFrame(void);
+  void beginPaint(void);
+  void endPaint(threadPool &workers);
   void flip(void);
+  void flip(const damageRegion &region);
+  void present(void);
   void resize(const int w, const int h);
   void clear(void);
+  void clear(const int x1, const int y1, const int x2, const int y2);
+  void invalidate(int x1, int y1, int x2, int y2);
+  void scroll(int x1, int y1, int x2, int y2, const int dx, const int dy);
   bool filled(void);
   std::string getFontFilename(const std::string &sTextFace);
 
@@ -717,13 +1475,29 @@ public:
   xcb_screen_t *m_screen;
   xcb_drawable_t m_window;
   xcb_gcontext_t m_graphics;
-  xcb_pixmap_t m_pix;
-  xcb_shm_segment_info_t m_info;
+
+  /* the surface is drawn into the back one of two shared memory images
+   while the other is shown. An image sent to the server is not drawn
+   again until the server notes its completion. When the server cannot
+   share memory, the surface is the offscreen buffer and the rectangles
+   are sent in put image requests. */
+  typedef struct {
+    xcb_shm_segment_info_t info;
+    int pending;
+  } sharedImage;
+  std::array<sharedImage, 2> m_images;
+  bool m_bSharedMemory;
+  std::size_t m_back;
+  uint8_t m_completionEvent;
+  std::deque<xcb_generic_event_t *> m_pendingEvents;
+  std::vector<u_int8_t> m_putBuffer;
+
+  // the rectangles sent with the other image, which the back one lacks.
+  damageRegion m_presented;
 
   // xcb -- keyboard
   xcb_key_symbols_t *m_syms;
   uint32_t m_foreground;
-  u_int8_t *m_screenMemoryBuffer;
 
 #elif defined(_WIN64)
   HWND m_hwnd;
@@ -739,12 +1513,105 @@ public:
   int fontScale;
   std::vector<u_int8_t> m_offscreenBuffer;
 
+  /// \brief the pixels drawn, those of the offscreen buffer or, with a
+  /// window on Linux, those of the back image.
+  u_int8_t *m_pixels;
+
+  glyphAtlasCache glyphAtlases;
+
+  /**
+  \brief the part of the surface to paint and send to the display. The
+  clearing and resizing of the surface damage all of it.
+  */
+  damageRegion damage;
+
+  /// \brief the part of the surface whose pixels were moved by scroll. It
+  /// is sent to the display along with the damage, yet not painted.
+  damageRegion moved;
+
 private:
   eventHandler dispatchEvent;
 
   unsigned short _w;
   unsigned short _h;
 
+  // the surface is only the offscreen buffer, no window is connected.
+  bool m_bHeadless;
+
+#if defined(__linux__)
+  bool createImages(void);
+  void restoreBackImage(void);
+  void waitForImage(sharedImage &image);
+  void releaseImages(void);
+  void putImage(const damageRegion::rectangle &r);
+  xcb_generic_event_t *nextEvent(void);
+#endif
+
+  // the drawing coordinates are moved by the origin, and pixels outside of
+  // the clipping rectangle are not touched.
+  int m_originX;
+  int m_originY;
+  int m_clipX1;
+  int m_clipY1;
+  int m_clipX2;
+  int m_clipY2;
+
+  /* a band of a box is the part of the rounded rectangle inset by outer
+   that is outside of the one inset by inner. An inner of -1 leaves no
+   hole. The corners of an inset have the radius of the box less the
+   inset, their coverage is that of cornerCoverage. The pixels nearer the
+   bottom or right edge of the box are painted with the shade, and a dash
+   other than zero paints dashes of that length separated by gaps along
+   each side. */
+  typedef struct {
+    int x;
+    int y;
+    int w;
+    int h;
+    int outer;
+    int outerRadius;
+    const std::uint8_t *outerCorner;
+    int inner;
+    int innerRadius;
+    const std::uint8_t *innerCorner;
+    unsigned int color;
+    unsigned int shade;
+    int dash;
+    int gap;
+    unsigned int alpha;
+  } boxBand;
+  std::vector<boxBand> m_bands;
+  std::unordered_map<int, std::vector<std::uint8_t>> m_corners;
+  const std::uint8_t *cornerCoverage(const int radius);
+  void drawBand(const int x1, const int y1, const int x2, const int y2,
+                const int outer, const int inner, const int radius,
+                const unsigned int color, const unsigned int shade,
+                const int dash, const int gap, const unsigned int alpha);
+  void paintBand(const boxBand &b, const int y, const int x1, const int x2);
+
+  /* the clearing, glyphs and bands drawn between beginPaint and endPaint
+   are recorded, then played for each tile of the surface on the workers.
+   The rectangle of a command is clipped when it is recorded. A band
+   command names its record within m_bands. */
+  typedef struct {
+    enum : std::uint8_t { clearing, glyphRun, bandRun } kind;
+    glyphAtlas *atlas;
+    glyphAtlas::glyph g;
+    int x;
+    int y;
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+    unsigned int color;
+    std::uint32_t band;
+  } paintCommand;
+  bool m_bRecording;
+  std::vector<paintCommand> m_commands;
+  std::vector<std::vector<std::uint32_t>> m_tiles;
+  static const int tileSize = 64;
+  void paint(const paintCommand &c, int x1, int y1, int x2, int y2);
+
 #ifdef USE_INLINE_RENDERER
   FT_Library m_freeType;
   FTC_Manager m_cacheManager;
@@ -758,6 +1625,8 @@ private:
 #endif
 
   FTC_CMapCache m_cmapCache;
+  resolvedFontCache m_fonts;
+
   std::unordered_map<std::string, faceCacheStruct> m_faceCache;
   typedef std::unordered_map<std::string, faceCacheStruct>::iterator
       faceCacheIterator;
@@ -857,6 +1726,40 @@ public:
 
   Element *ptr;
 
+  /* the inputs and outputs of the last layout pass. When none of the
+   inputs differ and the element's subtree is not dirty, the layout
+   pass reuses the rectangles of the subtree rather than computing them. */
+  bool bLayoutCached : 1;
+  bool bVisible : 1;
+  bool bDisplayNone : 1;
+  double penXIn;
+  double penYIn;
+  double parentMaxYIn;
+  double parentX1;
+  double parentX2;
+  double parentOw;
+  double parentOh;
+  double penXOut;
+  double penYOut;
+  double parentMaxYOut;
+  double subtreePenMaxX;
+  double subtreePenMaxY;
+
+  /* the offset of the scrolling elements that contain the item, and the
+   clipping rectangle formed by them. The painted bounds are the rectangle
+   moved by the offset and clipped, these are the ones that are indexed.
+   The scrolling of the viewer is not included. */
+  double scrollX;
+  double scrollY;
+  double clipX1;
+  double clipY1;
+  double clipX2;
+  double clipY2;
+  double paintX1;
+  double paintY1;
+  double paintX2;
+  double paintY2;
+
 public:
   /// \brief notes the bounds have been completely calculated.
   bool completed(void) {
@@ -865,6 +1768,41 @@ public:
   }
 };
 
+/**
+\internal
+\class spatialIndex
+\brief The spatialIndex is a uniform grid over the painted bounds of the
+display list. Each cell lists the positions, within the display list, of
+the items whose bounds overlap the cell. The queries return positions
+in increasing order, which is the order of painting. The index is built
+again when the display list changes.
+*/
+class spatialIndex {
+public:
+  spatialIndex()
+      : m_items(nullptr), m_x(0), m_y(0), m_cellSize(0), m_columns(0),
+        m_rows(0), m_queryID(0) {}
+  void build(const std::vector<displayListItem *> &items);
+  void query(const double x1, const double y1, const double x2,
+             const double y2, std::vector<std::size_t> &result);
+  std::optional<std::size_t> itemAt(const double x, const double y);
+
+private:
+  bool cellRange(double x1, double y1, double x2, double y2,
+                 std::size_t &c1, std::size_t &r1, std::size_t &c2,
+                 std::size_t &r2);
+
+  const std::vector<displayListItem *> *m_items;
+  double m_x;
+  double m_y;
+  double m_cellSize;
+  std::size_t m_columns;
+  std::size_t m_rows;
+  std::vector<std::vector<std::size_t>> m_cells;
+  std::vector<std::size_t> m_seen;
+  std::size_t m_queryID;
+};
+
 /**
   \class Element
   \brief This is the main Element API. All document entities have this
@@ -884,10 +1822,13 @@ public:
       : softName(_softName), penX(0), penY(0), maxX(0),maxY(0), m_self(this), m_parent(nullptr),
         m_firstChild(nullptr), m_lastChild(nullptr), m_nextChild(nullptr),
         m_previousChild(nullptr), m_nextSibling(nullptr),
-        m_previousSibling(nullptr), m_childCount(0), ingestStream(false) {
+        m_previousSibling(nullptr), m_childCount(0), ingestStream(false),
+        textFaceHeight(0), bEstimatedMetrics(false), retainedWrapWidth(-1),
+        retainedTextHeight(0), lineBoxWidth(-1), lineBoxHeight(0), bDirty(true), bChildDirty(true), bDamaged(true), displayList(), computedStyle(),
+        bStyleDirty(true), m_styleParentGeneration(0) {
     setAttribute(attribs);
   }
-  ~Element() { Visualizer::deallocate(surface); }
+  virtual ~Element() { Visualizer::deallocate(surface); }
   Element(const Element &other);
   Element(Element &&other) noexcept;
   Element &operator=(const Element &other);
@@ -924,11 +1865,16 @@ private:
   When just the data is passed, and a default transform function
   does not exist, the data is saved leaving the fnTransform as a default
   formatter according to the type.
+
+  Numbers are formatted with std::to_chars into one string, the text of
+  each is found by its offset. They are formatted when first needed after
+  the data was last given out for changing. Floating point values use six
+  significant digits, as a stream formats them.
   */
 private:
   template <typename T> class usageAdaptor {
   public:
-    usageAdaptor(void) {}
+    usageAdaptor(void) : bFormatted(false) {}
     usageAdaptor(std::vector<T> &_d) : _data(_d) { saveState(); }
     usageAdaptor(std::function<Element &(T &)> &_fn) : fnTransform(_fn) {
       saveState();
@@ -947,19 +1893,25 @@ private:
       return (_data);
     }
 
-    std::string get(std::size_t i) {
-      std::stringstream ss;
-      ss << _data[i];
-      return ss.str();
-    }
+    std::string get(std::size_t i) { return std::string(textData(i)); }
 
     std::size_t textDataSize(void) { return _data.size(); }
 
-    std::string textData(int index) {
-      std::stringstream ss;
-      T n = _data[index];
-      ss << n;
-      return ss.str();
+    /// \brief the text of the item, valid until the data is changed.
+    std::string_view textData(std::size_t index) {
+      if constexpr (std::is_same_v<T, std::string>) {
+        return _data[index];
+      } else if constexpr (formatsAsNumber) {
+        if (!bFormatted)
+          format();
+        return std::string_view(m_text).substr(
+            m_offsets[index], m_offsets[index + 1] - m_offsets[index]);
+      } else {
+        std::stringstream ss;
+        ss << _data[index];
+        m_text = ss.str();
+        return m_text;
+      }
     }
 
     std::function<Element &(T &)> &transform(void) { return fnTransform; }
@@ -971,9 +1923,41 @@ private:
     std::vector<T> _data;
     std::function<Element &(T &)> fnTransform;
     usageAdaptorState state;
+    bool bFormatted;
+    std::string m_text;
+    std::vector<std::size_t> m_offsets;
+
+    // a stream writes the characters and Booleans differently.
+    static constexpr bool formatsAsNumber =
+        std::is_floating_point_v<T> ||
+        (std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+         !std::is_same_v<T, char> && !std::is_same_v<T, signed char> &&
+         !std::is_same_v<T, unsigned char>);
 
   private:
-    void saveState(void) { state._size = _data.size(); }
+    void saveState(void) {
+      state._size = _data.size();
+      bFormatted = false;
+    }
+
+    void format(void) {
+      char buffer[64];
+      m_text.clear();
+      m_offsets.clear();
+      m_offsets.reserve(_data.size() + 1);
+      m_offsets.push_back(0);
+      for (auto &n : _data) {
+        std::to_chars_result result;
+        if constexpr (std::is_floating_point_v<T>)
+          result = std::to_chars(buffer, buffer + sizeof(buffer), n,
+                                 std::chars_format::general, 6);
+        else
+          result = std::to_chars(buffer, buffer + sizeof(buffer), n);
+        m_text.append(buffer, result.ptr);
+        m_offsets.push_back(m_text.size());
+      }
+      bFormatted = true;
+    }
   };
 
 public:
@@ -1113,6 +2097,9 @@ public:
 
   */
   template <typename T = std::string> auto &data(void) {
+    // the caller receives a mutable reference, so the content is presumed
+    // to change and the element is laid out again.
+    setDirty();
     auto tIndex = std::type_index(typeid(std::vector<T>));
     // if the requested data adaptor does not exist,
     // create its position within the adaptor member vector
@@ -1351,7 +2338,7 @@ public:
   std::vector<std::reference_wrapper<StyleClass>> styles;
 
 private:
-  std::unordered_map<std::type_index, std::any> attributes;
+  attributeTable attributes;
   std::unordered_map<std::type_index, std::any> m_usageAdaptorMap;
   std::size_t surface;
 
@@ -1362,9 +2349,11 @@ public:
   Display records are stored within the main Viewer class or _root
   element.
   */
-  void wordMetrics(Visualizer::platform &device);
-  double computeWrappedTextDataHeight(Visualizer::platform &device,
-                                      double dWrappingWidth);
+  void wordMetrics(Visualizer::fontContext &fonts, FTC_FaceID faceID);
+  void estimateWordMetrics(const double dAverageAdvance,
+                           const double dFaceHeight);
+  void evictWordMetrics(void);
+  double computeWrappedTextDataHeight(double dWrappingWidth);
   double computeWidestTextData(Visualizer::platform &device);
   typedef struct {
     double totalWidth;
@@ -1374,10 +2363,76 @@ public:
 
   std::map<std::pair<std::size_t, std::size_t>, std::vector<wordMetricType>>
       indexedWordMetrics;
+  /// \brief the height of the face, measured along with the words so that
+  /// the layout does not use the font engine.
+  double textFaceHeight;
   typedef std::map<std::size_t, std::vector<wordMetricType>>::iterator
       wordMetricsIterator;
+
+  /**
+  \internal
+  \brief Elements outside of the viewport are not measured word by word.
+  bEstimatedMetrics notes that indexedWordMetrics holds a single entry per
+  line of data, its width estimated from the character count, or kept from
+  an earlier measure when the word breaks were evicted. The wrapped height
+  of the last measured layout is retained along with the width it was
+  wrapped at.
+  */
+  bool bEstimatedMetrics;
+  double retainedWrapWidth;
+  double retainedTextHeight;
+
+  /**
+  \internal
+  \brief The line boxes are the wrapped lines of the text data for one
+  wrapping width. Each notes the data string, the range of its characters,
+  the width and the offset of the line from the top of the element. The
+  layout builds them when computing the height and painting draws from
+  them. They are built again when the width or the word metrics change.
+  */
+  typedef struct {
+    std::size_t storageTypeID;
+    std::size_t index;
+    std::size_t begin;
+    std::size_t end;
+    double width;
+    double y;
+  } lineBoxType;
+  std::vector<lineBoxType> lineBoxes;
+  double lineBoxWidth;
+  double lineBoxHeight;
+  void computeLineBoxes(double dWrappingWidth);
+
+  /**
+  \internal
+  \brief The dirty flags drive the incremental layout. bDirty notes that the
+  attributes, data or children of the element changed since it was last
+  laid out. bChildDirty notes that an element within the subtree is dirty.
+  Both are cleared by the layout pass of the Viewer. bDamaged is set with
+  bDirty and notes that the painting of the element may differ, it is
+  cleared by the Viewer when the element is painted.
+  */
+  bool bDirty;
+  bool bChildDirty;
+  bool bDamaged;
+  void setDirty(void);
+  void releasePainting(void);
   displayListItem displayList;
 
+  /**
+  \internal
+  \brief The resolved style of the element. resolveStyle is invoked by the
+  Viewer in tree order, parents first. The record is only built again when
+  the attributes, the attached style classes or the parent's style change.
+  */
+  ComputedStyle computedStyle;
+  void resolveStyle(void);
+
+private:
+  bool bStyleDirty;
+  std::size_t m_styleParentGeneration;
+  std::vector<std::pair<const StyleClass *, std::size_t>> m_styleSignature;
+
 public:
   auto appendChild(const std::string &sMarkup) -> Element &;
   auto appendChild(Element &newChild) -> Element &;
@@ -1461,12 +2516,8 @@ public:
 
   */
   template <typename ATTR_TYPE> ATTR_TYPE &getAttribute(void) {
-    ATTR_TYPE *ret = nullptr;
-    auto it = attributes.find(std::type_index(typeid(ATTR_TYPE)));
-    if (it != attributes.end()) {
-      ret = &std::any_cast<ATTR_TYPE &>(it->second);
-
-    } else {
+    ATTR_TYPE *ret = attributes.find<ATTR_TYPE>();
+    if (!ret) {
       std::string info = typeid(ret).name();
       info += " attribute not found";
 
@@ -1475,6 +2526,30 @@ public:
     return *ret;
   }
 
+  /**
+    \brief the templated function returns a pointer to the specified
+    attribute. The function does not throw.
+    \tparam ATTR_TYPE a named object.
+    \return a pointer to the attribute or nullptr when the attribute is not
+    associated with the element.
+  */
+  template <typename ATTR_TYPE> ATTR_TYPE *tryGetAttribute(void) {
+    return attributes.find<ATTR_TYPE>();
+  }
+
+  /**
+    \brief the templated function returns a copy of the specified attribute
+    or the given default when the attribute is not associated with the
+    element. The function does not throw.
+    \tparam ATTR_TYPE a named object.
+    \param defaultValue the value returned when not found.
+  */
+  template <typename ATTR_TYPE>
+  ATTR_TYPE getAttributeOr(const ATTR_TYPE &defaultValue) {
+    ATTR_TYPE *ret = attributes.find<ATTR_TYPE>();
+    return ret ? *ret : defaultValue;
+  }
+
 private:
   std::vector<eventHandler> onfocus;
   std::vector<eventHandler> onblur;
@@ -1571,6 +2646,7 @@ private:
   void processParseContext(parserContext &pc);
   auto ingestMarkup(Element &node, const std::string &markup) -> Element &;
   void updateIndexBy(const indexBy &setting);
+  void setChildDirty(void);
 }; // class Element
 
 // prototypes for the user defined literals
@@ -2022,6 +3098,7 @@ template <typename... Types> auto createStyle(Types... args) -> StyleClass & {
 }
 
 auto query(const std::string &queryString) -> ElementList;
+void prewarmTextFaces(const std::vector<std::string> &faces);
 auto query(const ElementQuery &queryFunction) -> ElementList;
 
 /**
@@ -2080,16 +3157,124 @@ public:
   Viewer &operator=(Viewer &&other) noexcept {} // move assignment
   void render();
   void processEvents(void);
+  void renderFrames(const std::size_t frames);
+  void writeImage(const std::string &sFilename);
   void dispatchEvent(const event &e);
+  auto elementFromPoint(const double x, const double y)
+      -> std::optional<std::reference_wrapper<Element>>;
+  void releasePainting(Element &e);
+
+  /**
+  \brief the distance, in pixels, beyond each edge of the viewport within
+  which the text of elements is measured word by word. Elements further
+  away are laid out with estimated extents until they come near.
+  */
+  double overscan;
+
+  /**
+  \brief the number of threads that measure, lay out and paint, the calling
+  thread being one of them. It is read when the first frame is laid out,
+  zero uses one thread for each processor.
+  */
+  std::size_t workerThreads;
+
+  /**
+  \brief The durations, in milliseconds, of the phases of the last frame.
+  The style phase resolves the computed styles, measure is the text
+  metrics, layout is the walk of the document and displayList is the
+  building and sorting of the display list along with its index. The
+  layout phases are summed over the passes made within the frame.
+  */
+  typedef struct {
+    double style;
+    double measure;
+    double layout;
+    double displayList;
+    double render;
+    double flip;
+  } frameTimings;
+  frameTimings timings;
+
+  /**
+  \brief The totals of the word width caches of the text measurement
+  workers. Each worker keeps its own cache of wordCacheCapacity words, they
+  are kept from one frame to the next.
+  */
+  typedef struct {
+    std::size_t hits;
+    std::size_t misses;
+    std::size_t evictions;
+    std::size_t entries;
+  } wordCacheStatistics;
+  wordCacheStatistics wordCacheStatus(void);
+  std::size_t wordCacheCapacity;
+
+  /**
+  \brief The counters of the glyph atlases of the platform. The glyphs
+  drawn are kept within glyphCacheBudget bytes.
+  */
+  typedef struct {
+    std::size_t hits;
+    std::size_t misses;
+    std::size_t evictions;
+    std::size_t bytes;
+  } glyphCacheStatistics;
+  glyphCacheStatistics glyphCacheStatus(void);
+  std::size_t glyphCacheBudget;
 
 private:
-  void treeOrderComputeLayout(double &penx, double &penY, Element &e);
+  bool computeElementLayout(double &penx, double &penY, Element &e);
+  void treeOrderComputeLayout(Element &e, const std::size_t worker);
+  bool initializeLayout(Element &e);
+  void treeOrderResolveStyle(Element &e);
+  void appendDisplayList(Element &e, double scrollX, double scrollY,
+                         double clipX1, double clipY1, double clipX2,
+                         double clipY2);
   void computeLayout(Element &e);
+  void layoutDocument(void);
+  void measureRegion(double &x1, double &y1, double &x2, double &y2);
+  void measureText(void);
+  void measureWords(std::vector<std::pair<Element *, FTC_FaceID>> &work);
+  void estimateText(Element &e, FTC_FaceID faceID);
+  bool measureVisibleText(void);
+  void evictText(void);
+  double lapTime(std::chrono::steady_clock::time_point &lap);
+  void damageChanges(const double dScrollX, const double dScrollY);
 
 private:
   std::unique_ptr<Visualizer::platform> m_device;
+  std::unique_ptr<threadPool> m_workers;
+  std::vector<std::unique_ptr<Visualizer::fontContext>> m_measureContexts;
+
+  /// \brief the face height and average advance, per face and point size,
+  /// used to estimate the extents of elements that are not measured.
+  std::map<std::pair<FTC_FaceID, int>, std::pair<double, double>>
+      m_faceEstimates;
 
   std::vector<displayListItem *> m_displayList;
+  spatialIndex m_displayIndex;
+  std::vector<std::size_t> m_visibleItems;
+
+  /// \brief the surface rectangle of each element painted by the last
+  /// frame, along with the scrolling it was painted at.
+  std::unordered_map<Element *, Visualizer::damageRegion::rectangle>
+      m_painted;
+  std::unordered_map<Element *, Visualizer::damageRegion::rectangle>
+      m_painting;
+  double m_paintedScrollX;
+  double m_paintedScrollY;
+
+  /// \brief the scrolling offsets of the elements that scroll, as the
+  /// last frame painted their children.
+  typedef struct {
+    double x;
+    double y;
+  } scrollOffset;
+  std::unordered_map<Element *, scrollOffset> m_paintedScrolls;
+  std::unordered_map<Element *, scrollOffset> m_paintingScrolls;
+  bool scrollPixels(const std::size_t idx,
+                    const Visualizer::damageRegion::rectangle &r,
+                    const int dx, const int dy);
 };
 }; // namespace viewManager
 